@@ -0,0 +1,365 @@
+// Benchmarks that drive NAM::Plugin through the in-process host.
+//
+//   nam_bench browse [options] <model> <model> ...
+//     Simulates a user scrolling through a model folder: fires patch:Set requests for the given
+//     models at a fixed rate while audio runs in real time, then measures how long it takes for
+//     the last requested model to be installed.
+//
+//   nam_bench process [options] <model>
+//     Loads a model and times process() calls back to back at one or more block sizes,
+//     reporting per-block time percentiles and how much faster than real time the plugin runs.
+//     With --automate, the input and output levels also change at several frames in every block,
+//     so automated and static sessions can be compared.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nam_host.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+	double sampleRate = 48000;
+	std::vector<uint32_t> blockSizes = { 128 };
+	double seconds = 10;
+	float qualityScale = 1;
+	uint32_t automationEvents = 0;
+	double setsPerSecond = 200;
+	uint32_t numSets = 500;
+	int32_t modelCacheSizeMB = 0;
+	const char* traceFile = nullptr;
+	std::vector<std::string> models;
+};
+
+static void print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s browse [options] <model> <model> ...\n"
+		"       %s process [options] <model>\n"
+		"  --rate <hz>                Sample rate (default: 48000)\n"
+		"  --block <samples>[,...]    Block size(s) - browse uses the first (default: 128)\n"
+		"  --max-block-length <max>   Process every power of two block size up to max, passing max\n"
+		"                             to the plugin as the host's maxBlockLength (process)\n"
+		"  --seconds <seconds>        Audio to process per block size (process, default: 10)\n"
+		"  --quality <scale>          Quality scale (process, default: 1)\n"
+		"  --automate <count>         Timestamped level changes per block (process, default: 0)\n"
+		"  --sets-per-second <count>  Model change rate (browse, default: 200)\n"
+		"  --sets <count>             Number of model changes (browse, default: 500)\n"
+		"  --cache-size <MB>          Model cache size (browse, default: 0)\n"
+#ifdef TRACING_ENABLED
+		"  --trace <file>             Write a Chrome/Perfetto trace when done\n"
+#endif
+		, name, name);
+}
+
+static bool parse_options(int argc, char* argv[], Options& options)
+{
+	for (int i = 2; i < argc; i++)
+	{
+		const char* arg = argv[i];
+
+		if (strncmp(arg, "--", 2) != 0)
+		{
+			options.models.push_back(arg);
+
+			continue;
+		}
+
+		if (i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if (!strcmp(arg, "--rate"))
+			options.sampleRate = atof(value);
+		else if (!strcmp(arg, "--block"))
+		{
+			options.blockSizes.clear();
+
+			for (const char* size = value; size != nullptr; size = strchr(size, ','))
+			{
+				if (*size == ',')
+					size++;
+
+				options.blockSizes.push_back((uint32_t)atoi(size));
+			}
+		}
+		else if (!strcmp(arg, "--max-block-length"))
+		{
+			uint32_t maxBlockLength = (uint32_t)atoi(value);
+
+			options.blockSizes.clear();
+
+			for (uint32_t size = 16; size < maxBlockLength; size *= 2)
+				options.blockSizes.push_back(size);
+
+			options.blockSizes.push_back(maxBlockLength);
+		}
+		else if (!strcmp(arg, "--seconds"))
+			options.seconds = atof(value);
+		else if (!strcmp(arg, "--quality"))
+			options.qualityScale = (float)atof(value);
+		else if (!strcmp(arg, "--automate"))
+			options.automationEvents = (uint32_t)atoi(value);
+		else if (!strcmp(arg, "--sets-per-second"))
+			options.setsPerSecond = atof(value);
+		else if (!strcmp(arg, "--sets"))
+			options.numSets = (uint32_t)atoi(value);
+		else if (!strcmp(arg, "--cache-size"))
+			options.modelCacheSizeMB = atoi(value);
+#ifdef TRACING_ENABLED
+		else if (!strcmp(arg, "--trace"))
+			options.traceFile = value;
+#endif
+		else
+			return false;
+	}
+
+	return (options.sampleRate > 0) &&
+		std::none_of(options.blockSizes.begin(), options.blockSizes.end(), [](uint32_t size) { return size == 0; });
+}
+
+static void fill_input(std::vector<float>& input, double sampleRate, uint64_t& phase)
+{
+	for (auto& sample : input)
+	{
+		sample = 0.25f * sinf((float)(2 * 3.14159265358979 * 110 * (double)(phase++) / sampleRate));
+	}
+}
+
+// Level changes spread evenly through the block, sweeping both levels through +/-6 dB
+static bool automate_levels(NAM::Host& host, uint32_t blockSize, uint32_t numEvents, uint64_t& eventCount)
+{
+	for (uint32_t event = 0; event < numEvents; event++)
+	{
+		float level = 6 * sinf((float)(eventCount++) * 0.01f);
+
+		if (!host.automate_levels((uint32_t)(((uint64_t)(event + 1) * blockSize) / (numEvents + 1)), level, -level))
+		{
+			fprintf(stderr, "Unable to send %u level changes in one block\n", numEvents);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool write_trace(const Options& options)
+{
+#ifdef TRACING_ENABLED
+	if ((options.traceFile != nullptr) && !NAM::Trace::write_chrome_trace(options.traceFile))
+	{
+		fprintf(stderr, "Unable to write trace to: '%s'\n", options.traceFile);
+
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+static int run_browse(const Options& options)
+{
+	if ((options.models.size() < 2) || (options.setsPerSecond <= 0) || (options.numSets == 0))
+	{
+		fprintf(stderr, "browse needs at least two models, a positive rate and at least one set\n");
+
+		return 1;
+	}
+
+	uint32_t blockSize = options.blockSizes[0];
+
+	NAM::Host host;
+
+	if (!host.initialize(options.sampleRate, (int)blockSize, true))
+		return 1;
+
+	if (options.modelCacheSizeMB > 0)
+		host.set_model_cache_size(options.modelCacheSizeMB);
+
+	std::vector<float> input(blockSize);
+	std::vector<float> output(blockSize);
+	uint64_t phase = 0;
+
+	auto blockDuration = std::chrono::duration<double>(blockSize / options.sampleRate);
+
+	auto start = Clock::now();
+	auto lastSetTime = start;
+	auto timeout = std::chrono::seconds(60);
+
+	uint32_t setsSent = 0;
+	size_t modelIndex = 0;
+	std::string lastPath;
+	double maxBlockMs = 0;
+
+	for (uint64_t block = 0;; block++)
+	{
+		auto blockStart = Clock::now();
+
+		uint32_t setsDue = std::min(options.numSets,
+			(uint32_t)(std::chrono::duration<double>(blockStart - start).count() * options.setsPerSecond) + 1);
+
+		for (; setsSent < setsDue; setsSent++)
+		{
+			// make sure the final request is an actual change so we can see it land
+			if ((setsSent == options.numSets - 1) && (options.models[modelIndex] == host.plugin.currentModelPath))
+				modelIndex = (modelIndex + 1) % options.models.size();
+
+			lastPath = options.models[modelIndex];
+			modelIndex = (modelIndex + 1) % options.models.size();
+
+			host.request_model(lastPath.c_str());
+
+			lastSetTime = blockStart;
+		}
+
+		fill_input(input, options.sampleRate, phase);
+
+		host.process(input.data(), output.data(), blockSize);
+
+		maxBlockMs = std::max(maxBlockMs, std::chrono::duration<double, std::milli>(Clock::now() - blockStart).count());
+
+		if (setsSent == options.numSets)
+		{
+			if ((host.plugin.currentModel != nullptr) && (host.plugin.currentModelPath == lastPath))
+				break;
+
+			if ((Clock::now() - lastSetTime) > timeout)
+			{
+				fprintf(stderr, "Timed out waiting for '%s' to load\n", lastPath.c_str());
+
+				return 1;
+			}
+		}
+
+		std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(blockDuration * (double)(block + 1)));
+	}
+
+	double timeToFinalMs = std::chrono::duration<double, std::milli>(Clock::now() - lastSetTime).count();
+	double totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	printf("model sets:          %u (%.0f/s)\n", setsSent, options.setsPerSecond);
+	printf("loads scheduled:     %u\n", host.get_num_load_requests());
+	printf("loads completed:     %u\n", host.get_num_loaded_models());
+	printf("time to final model: %.2f ms\n", timeToFinalMs);
+	printf("total time:          %.2f s\n", totalSeconds);
+	printf("max process() time:  %.3f ms (block is %.3f ms)\n", maxBlockMs, blockDuration.count() * 1000);
+
+	return write_trace(options) ? 0 : 1;
+}
+
+static int run_process(const Options& options)
+{
+	if ((options.models.size() != 1) || (options.seconds <= 0))
+	{
+		fprintf(stderr, "process needs exactly one model and a positive duration\n");
+
+		return 1;
+	}
+
+	if (options.automationEvents > (MAX_LEVEL_SEGMENTS - 1))
+	{
+		fprintf(stderr, "automate supports up to %d level changes per block\n", MAX_LEVEL_SEGMENTS - 1);
+
+		return 1;
+	}
+
+	uint32_t maxBlockSize = *std::max_element(options.blockSizes.begin(), options.blockSizes.end());
+
+	NAM::Host host;
+
+	if (!host.initialize(options.sampleRate, (int)maxBlockSize))
+		return 1;
+
+	host.set_quality_scale(options.qualityScale);
+
+	std::vector<float> input(maxBlockSize);
+	std::vector<float> output(maxBlockSize);
+	uint64_t phase = 0;
+	uint64_t automationCount = 0;
+
+	// the synchronous worker loads and installs the model right after this call
+	host.request_model(options.models[0].c_str());
+	host.process(input.data(), output.data(), 0);
+
+	if (host.plugin.currentModel == nullptr)
+	{
+		fprintf(stderr, "Unable to load model from: '%s'\n", options.models[0].c_str());
+
+		return 1;
+	}
+
+	if (options.automationEvents > 0)
+		printf("automating levels %u times per block\n", options.automationEvents);
+
+	printf("%-8s %10s %10s %10s %10s %10s %10s\n", "block", "first us", "mean us", "p50 us", "p99 us", "max us", "realtime");
+
+	for (uint32_t blockSize : options.blockSizes)
+	{
+		size_t numBlocks = std::max((size_t)1, (size_t)(options.seconds * options.sampleRate / blockSize));
+
+		std::vector<double> blockTimes;
+		blockTimes.reserve(numBlocks);
+
+		for (size_t block = 0; block < numBlocks; block++)
+		{
+			fill_input(input, options.sampleRate, phase);
+
+			if (!automate_levels(host, blockSize, options.automationEvents, automationCount))
+				return 1;
+
+			auto start = Clock::now();
+
+			host.process(input.data(), output.data(), blockSize);
+
+			blockTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+		}
+
+		double first = blockTimes[0];
+		double mean = 0;
+
+		for (double time : blockTimes)
+			mean += time;
+
+		mean /= blockTimes.size();
+
+		std::sort(blockTimes.begin(), blockTimes.end());
+
+		double blockUs = blockSize / options.sampleRate * 1e6;
+
+		printf("%-8u %10.2f %10.2f %10.2f %10.2f %10.2f %9.1fx\n", blockSize, first, mean,
+			blockTimes[blockTimes.size() / 2], blockTimes[std::min(blockTimes.size() - 1, (blockTimes.size() * 99) / 100)],
+			blockTimes.back(), blockUs / mean);
+	}
+
+	return write_trace(options) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+
+	if ((argc < 2) || !parse_options(argc, argv, options))
+	{
+		print_usage(argv[0]);
+
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "browse"))
+		return run_browse(options);
+
+	if (!strcmp(argv[1], "process"))
+		return run_process(options);
+
+	print_usage(argv[0]);
+
+	return 1;
+}
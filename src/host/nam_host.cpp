@@ -0,0 +1,387 @@
+#include <cfenv>
+#include <cstring>
+#include <utility>
+
+#include "architecture.hpp"
+
+#include "nam_host.h"
+
+namespace NAM {
+	Host::Host()
+	{
+		map.handle = this;
+		map.map = map_uri;
+
+		schedule.handle = this;
+		schedule.schedule_work = schedule_work;
+	}
+
+	Host::~Host()
+	{
+		if (threaded)
+		{
+			{
+				std::lock_guard<std::mutex> lock(workMutex);
+
+				stopWorker = true;
+			}
+
+			workCondition.notify_one();
+			workerThread.join();
+		}
+
+		// models loaded but never installed
+		for (auto& data : pendingResponses)
+		{
+			auto msg = reinterpret_cast<const LV2SwitchModelMsg*>(data.data());
+
+			if (msg->type != kWorkTypeSwitch)
+				continue;
+
+			if (freeModel)
+				freeModel(msg->model);
+			else
+				delete msg->model;
+		}
+
+		// hand the installed model back instead of letting the plugin delete it
+		if (freeModel && (plugin.currentModel != nullptr))
+		{
+			freeModel(plugin.currentModel);
+
+			plugin.currentModel = nullptr;
+		}
+	}
+
+	bool Host::initialize(double rate, int maxBlockSize, bool threadedWorker) noexcept
+	{
+		int32_t blockLength = maxBlockSize;
+
+		LV2_Options_Option options[] =
+		{
+			{ LV2_OPTIONS_INSTANCE, 0, map_uri(this, LV2_BUF_SIZE__maxBlockLength), sizeof(int32_t), map_uri(this, LV2_ATOM__Int), &blockLength },
+			{ LV2_OPTIONS_INSTANCE, 0, 0, 0, 0, nullptr }
+		};
+
+		const LV2_Feature mapFeature = { LV2_URID__map, &map };
+		const LV2_Feature scheduleFeature = { LV2_WORKER__schedule, &schedule };
+		const LV2_Feature optionsFeature = { LV2_OPTIONS__options, options };
+
+		const LV2_Feature* features[] = { &mapFeature, &scheduleFeature, &optionsFeature, nullptr };
+
+		if (!plugin.initialize(rate, features))
+			return false;
+
+		patchSet = map_uri(this, LV2_PATCH__Set);
+		patchProperty = map_uri(this, LV2_PATCH__property);
+		patchValue = map_uri(this, LV2_PATCH__value);
+		modelPath = map_uri(this, MODEL_URI);
+		inputLevelParameter = map_uri(this, INPUT_LEVEL_URI);
+		outputLevelParameter = map_uri(this, OUTPUT_LEVEL_URI);
+		modelCacheSize = map_uri(this, MODEL_CACHE_SIZE_URI);
+		unitsFrame = map_uri(this, LV2_UNITS__frame);
+
+		lv2_atom_forge_init(&controlForge, &map);
+		clear_control();
+
+		plugin.ports.control = reinterpret_cast<const LV2_Atom_Sequence*>(controlBuffer);
+		plugin.ports.notify = reinterpret_cast<LV2_Atom_Sequence*>(notifyBuffer);
+		plugin.ports.input_level = &inputLevel;
+		plugin.ports.output_level = &outputLevel;
+		plugin.ports.quality_scale = &qualityScale;
+		plugin.ports.gate_threshold = &gateThreshold;
+		plugin.ports.gate_hysteresis = &gateHysteresis;
+		plugin.ports.gate_hold = &gateHold;
+		plugin.ports.gate_release = &gateRelease;
+
+		if (threadedWorker)
+		{
+			threaded = true;
+
+			workerThread = std::thread(&Host::worker_loop, this);
+		}
+
+		initialized = true;
+
+		return true;
+	}
+
+	void Host::set_levels(float inputLevelDB, float outputLevelDB) noexcept
+	{
+		inputLevel = inputLevelDB;
+		outputLevel = outputLevelDB;
+	}
+
+	void Host::set_quality_scale(float scale) noexcept
+	{
+		qualityScale = scale;
+	}
+
+	void Host::set_gate(float thresholdDB, float hysteresisDB, float holdMS, float releaseMS) noexcept
+	{
+		gateThreshold = thresholdDB;
+		gateHysteresis = hysteresisDB;
+		gateHold = holdMS;
+		gateRelease = releaseMS;
+	}
+
+	void Host::set_model(NeuralAudio::NeuralModel* model, const char* path)
+	{
+		if (!initialized)
+		{
+			// the plugin has no worker to swap it in through
+			if (freeModel && (model != nullptr))
+				freeModel(model);
+			else
+				delete model;
+
+			return;
+		}
+
+		LV2SwitchModelMsg msg = { kWorkTypeSwitch, plugin.next_load_generation(), {}, model };
+
+		if (path != nullptr)
+			strncpy(msg.path, path, MAX_FILE_NAME - 1);
+
+		auto data = reinterpret_cast<const uint8_t*>(&msg);
+
+		{
+			std::lock_guard<std::mutex> lock(responseMutex);
+
+			pendingResponses.emplace_back(data, data + sizeof(msg));
+		}
+
+		if (threaded)
+			deliver_responses();
+		else
+			run_worker();
+	}
+
+	void Host::request_model(const char* path)
+	{
+		LV2_Atom_Forge_Frame frame;
+
+		lv2_atom_forge_frame_time(&controlForge, 0);
+		lv2_atom_forge_object(&controlForge, &frame, 0, patchSet);
+
+		lv2_atom_forge_key(&controlForge, patchProperty);
+		lv2_atom_forge_urid(&controlForge, modelPath);
+		lv2_atom_forge_key(&controlForge, patchValue);
+		lv2_atom_forge_path(&controlForge, path, (uint32_t)strlen(path) + 1);
+
+		lv2_atom_forge_pop(&controlForge, &frame);
+	}
+
+	void Host::set_model_cache_size(int32_t sizeMB)
+	{
+		LV2_Atom_Forge_Frame frame;
+
+		lv2_atom_forge_frame_time(&controlForge, 0);
+		lv2_atom_forge_object(&controlForge, &frame, 0, patchSet);
+
+		lv2_atom_forge_key(&controlForge, patchProperty);
+		lv2_atom_forge_urid(&controlForge, modelCacheSize);
+		lv2_atom_forge_key(&controlForge, patchValue);
+		lv2_atom_forge_int(&controlForge, sizeMB);
+
+		lv2_atom_forge_pop(&controlForge, &frame);
+	}
+
+	bool Host::automate_levels(uint32_t frame, float inputLevelDB, float outputLevelDB)
+	{
+		// check up front so we never send half of a pair
+		if ((controlForge.offset + (2 * LEVEL_EVENT_SIZE)) > controlForge.size)
+			return false;
+
+		const std::pair<LV2_URID, float> levels[] = { { inputLevelParameter, inputLevelDB }, { outputLevelParameter, outputLevelDB } };
+
+		for (const auto& level : levels)
+		{
+			LV2_Atom_Forge_Frame objectFrame;
+
+			lv2_atom_forge_frame_time(&controlForge, frame);
+			lv2_atom_forge_object(&controlForge, &objectFrame, 0, patchSet);
+
+			lv2_atom_forge_key(&controlForge, patchProperty);
+			lv2_atom_forge_urid(&controlForge, level.first);
+			lv2_atom_forge_key(&controlForge, patchValue);
+			lv2_atom_forge_float(&controlForge, level.second);
+
+			lv2_atom_forge_pop(&controlForge, &objectFrame);
+		}
+
+		return true;
+	}
+
+	void Host::set_free_model_function(FreeModelFunction function)
+	{
+		freeModel = std::move(function);
+	}
+
+	void Host::process(const float* input, float* output, uint32_t numSamples) noexcept
+	{
+		plugin.ports.audio_in = input;
+		plugin.ports.audio_out = output;
+
+		// the notify port gets the full buffer capacity every cycle
+		reinterpret_cast<LV2_Atom*>(notifyBuffer)->size = NOTIFY_BUFFER_SIZE;
+
+#ifdef DISABLE_DENORMALS	// Disable floating point denormals
+		std::fenv_t fe_state;
+		std::feholdexcept(&fe_state);
+		disable_denormals();
+#endif
+
+		plugin.process(numSamples);
+
+#ifdef DISABLE_DENORMALS	// restore previous floating point state
+		std::feupdateenv(&fe_state);
+#endif
+
+		clear_control();
+
+		if (threaded)
+			deliver_responses();
+		else
+			run_worker();
+	}
+
+	LV2_URID Host::map_uri(LV2_URID_Map_Handle handle, const char* uri)
+	{
+		auto host = static_cast<Host*>(handle);
+
+		auto found = host->uridMap.find(uri);
+
+		if (found != host->uridMap.end())
+			return found->second;
+
+		LV2_URID urid = (LV2_URID)host->uridMap.size() + 1;
+
+		host->uridMap.emplace(uri, urid);
+
+		return urid;
+	}
+
+	LV2_Worker_Status Host::schedule_work(LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+	{
+		auto host = static_cast<Host*>(handle);
+		auto bytes = static_cast<const uint8_t*>(data);
+
+		if (*(const LV2WorkType*)data == kWorkTypeLoad)
+			host->numLoadRequests++;
+
+		if (host->threaded)
+		{
+			{
+				std::lock_guard<std::mutex> lock(host->workMutex);
+
+				host->workQueue.emplace_back(bytes, bytes + size);
+			}
+
+			host->workCondition.notify_one();
+		}
+		else
+		{
+			host->pendingWork.emplace_back(bytes, bytes + size);
+		}
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	LV2_Worker_Status Host::respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+	{
+		auto host = static_cast<Host*>(handle);
+		auto bytes = static_cast<const uint8_t*>(data);
+
+		if ((*(const LV2WorkType*)data == kWorkTypeSwitch) && (static_cast<const LV2SwitchModelMsg*>(data)->model != nullptr))
+			host->numLoadedModels++;
+
+		std::lock_guard<std::mutex> lock(host->responseMutex);
+
+		host->pendingResponses.emplace_back(bytes, bytes + size);
+
+		return LV2_WORKER_SUCCESS;
+	}
+
+	void Host::run_work(const std::vector<uint8_t>& data)
+	{
+		if (freeModel && (*(const LV2WorkType*)data.data() == kWorkTypeFree))
+		{
+			freeModel(reinterpret_cast<const LV2FreeModelMsg*>(data.data())->model);
+
+			return;
+		}
+
+		Plugin::work(&plugin, respond, this, (uint32_t)data.size(), data.data());
+	}
+
+	void Host::deliver_responses()
+	{
+		std::vector<std::vector<uint8_t>> responses;
+
+		{
+			std::lock_guard<std::mutex> lock(responseMutex);
+
+			responses.swap(pendingResponses);
+		}
+
+		for (auto& data : responses)
+		{
+			Plugin::work_response(&plugin, (uint32_t)data.size(), data.data());
+		}
+	}
+
+	void Host::run_worker()
+	{
+		// responses can schedule more work (ie: freeing the previous model), so loop until both are drained
+		for (;;)
+		{
+			auto work = std::move(pendingWork);
+			pendingWork.clear();
+
+			for (auto& data : work)
+			{
+				run_work(data);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(responseMutex);
+
+				if (pendingWork.empty() && pendingResponses.empty())
+					return;
+			}
+
+			deliver_responses();
+		}
+	}
+
+	void Host::worker_loop()
+	{
+		for (;;)
+		{
+			std::vector<uint8_t> data;
+
+			{
+				std::unique_lock<std::mutex> lock(workMutex);
+
+				workCondition.wait(lock, [this] { return stopWorker || !workQueue.empty(); });
+
+				// drain everything before stopping so no model is leaked
+				if (workQueue.empty())
+					return;
+
+				data = std::move(workQueue.front());
+				workQueue.pop_front();
+			}
+
+			run_work(data);
+		}
+	}
+
+	void Host::clear_control()
+	{
+		// leave the sequence frame open so request_model() can append events to it
+		lv2_atom_forge_set_buffer(&controlForge, controlBuffer, CONTROL_BUFFER_SIZE);
+		lv2_atom_forge_sequence_head(&controlForge, &controlFrame, unitsFrame);
+	}
+}
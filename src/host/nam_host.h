@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "nam_plugin.h"
+
+namespace NAM {
+	// Minimal in-process LV2 host for running NAM::Plugin outside of a plugin host.
+	// By default worker requests are run synchronously right after each process() call, so the
+	// plugin sees the same schedule/work/work_response sequence as under a real host. With a
+	// threaded worker they run on a separate thread instead, and responses are delivered after
+	// the next process() call, as a real host would.
+	class Host {
+	public:
+		using FreeModelFunction = std::function<void(NeuralAudio::NeuralModel* model)>;
+
+		Plugin plugin;
+
+		Host();
+		~Host();
+
+		bool initialize(double rate, int maxBlockSize, bool threadedWorker = false) noexcept;
+		bool is_initialized() const noexcept { return initialized; }
+
+		void set_levels(float inputLevelDB, float outputLevelDB) noexcept;
+		void set_quality_scale(float qualityScale) noexcept;
+		void set_gate(float thresholdDB, float hysteresisDB, float holdMS, float releaseMS) noexcept;
+
+		// Install an already loaded model, as if it came back from the worker. Before initialize() has
+		// succeeded the model is handed straight back for freeing instead.
+		void set_model(NeuralAudio::NeuralModel* model, const char* path);
+
+		// Send a patch:Set for the model path on the control port with the next process() call
+		void request_model(const char* path);
+
+		// Send a patch:Set for the model cache size (in MB) with the next process() call
+		void set_model_cache_size(int32_t sizeMB);
+
+		// Send timestamped patch:Sets for the input and output levels with the next process() call.
+		// Calls for the same block must be made in frame order. Returns false if the control buffer is full.
+		bool automate_levels(uint32_t frame, float inputLevelDB, float outputLevelDB);
+
+		// Called with models the plugin hands back for freeing. Defaults to deleting them on the worker.
+		void set_free_model_function(FreeModelFunction function);
+
+		void process(const float* input, float* output, uint32_t numSamples) noexcept;
+
+		// Model loads the plugin has scheduled, and models the worker has loaded and sent back
+		uint32_t get_num_load_requests() const noexcept { return numLoadRequests; }
+		uint32_t get_num_loaded_models() const noexcept { return numLoadedModels; }
+
+	private:
+		// a timestamped patch:Set of a float property
+		static constexpr size_t LEVEL_EVENT_SIZE = 72;
+		// room for a full block of level automation on top of model requests
+		static constexpr size_t CONTROL_BUFFER_SIZE = 4096 + (2 * MAX_LEVEL_SEGMENTS * LEVEL_EVENT_SIZE);
+		static constexpr size_t NOTIFY_BUFFER_SIZE = 4096;
+
+		static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char* uri);
+		static LV2_Worker_Status schedule_work(LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data);
+		static LV2_Worker_Status respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data);
+
+		void run_work(const std::vector<uint8_t>& data);
+		void deliver_responses();
+		void run_worker();
+		void worker_loop();
+		void clear_control();
+
+		std::unordered_map<std::string, LV2_URID> uridMap;
+		LV2_URID_Map map = {};
+		LV2_Worker_Schedule schedule = {};
+
+		LV2_Atom_Forge controlForge = {};
+		LV2_Atom_Forge_Frame controlFrame = {};
+		LV2_URID patchSet = 0;
+		LV2_URID patchProperty = 0;
+		LV2_URID patchValue = 0;
+		LV2_URID modelPath = 0;
+		LV2_URID inputLevelParameter = 0;
+		LV2_URID outputLevelParameter = 0;
+		LV2_URID modelCacheSize = 0;
+		LV2_URID unitsFrame = 0;
+
+		alignas(8) uint8_t controlBuffer[CONTROL_BUFFER_SIZE] = {};
+		alignas(8) uint8_t notifyBuffer[NOTIFY_BUFFER_SIZE] = {};
+
+		float inputLevel = 0;
+		float outputLevel = 0;
+		float qualityScale = 1;
+		float gateThreshold = NoiseGate::OFF_DB;
+		float gateHysteresis = 6;
+		float gateHold = 50;
+		float gateRelease = 100;
+
+		std::vector<std::vector<uint8_t>> pendingWork;
+
+		std::mutex responseMutex;
+		std::vector<std::vector<uint8_t>> pendingResponses;
+
+		bool initialized = false;
+		bool threaded = false;
+		std::thread workerThread;
+		std::mutex workMutex;
+		std::condition_variable workCondition;
+		std::deque<std::vector<uint8_t>> workQueue;
+		bool stopWorker = false;
+
+		std::atomic<uint32_t> numLoadRequests = 0;
+		std::atomic<uint32_t> numLoadedModels = 0;
+
+		FreeModelFunction freeModel;
+	};
+}
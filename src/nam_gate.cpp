@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "nam_gate.h"
+
+namespace NAM {
+	void NoiseGate::set_sample_rate(double rate) noexcept
+	{
+		sampleRate = rate;
+
+		update_coefficients();
+	}
+
+	void NoiseGate::set_parameters(float newThresholdDB, float newHysteresisDB, float newHoldMS, float newReleaseMS) noexcept
+	{
+		if ((newThresholdDB == thresholdDB) && (newHysteresisDB == hysteresisDB) && (newHoldMS == holdMS) && (newReleaseMS == releaseMS))
+			return;
+
+		thresholdDB = newThresholdDB;
+		hysteresisDB = newHysteresisDB;
+		holdMS = newHoldMS;
+		releaseMS = newReleaseMS;
+
+		update_coefficients();
+	}
+
+	void NoiseGate::update_coefficients() noexcept
+	{
+		bool wasEnabled = enabled;
+
+		enabled = (thresholdDB > OFF_DB);
+
+		if (!enabled || !wasEnabled)
+		{
+			// start (or stay) fully open so enabling the gate doesn't fade in existing signal
+			gain = 1;
+			open = true;
+			holdRemaining = 0;
+			closedSamples = 0;
+		}
+
+		openThreshold = powf(10, thresholdDB * 0.05f);
+		closeThreshold = powf(10, (thresholdDB - std::max(hysteresisDB, 0.0f)) * 0.05f);
+
+		holdSamples = (uint32_t)(std::max(holdMS, 0.0f) * 0.001 * sampleRate);
+
+		attackStep = 1.0f / std::max(1.0f, (float)(ATTACK_MS * 0.001 * sampleRate));
+		releaseStep = 1.0f / std::max(1.0f, (float)(std::max(releaseMS, 0.0f) * 0.001 * sampleRate));
+
+		envelopeDecay = expf(-(float)DETECT_BLOCK_SIZE / (float)(ENVELOPE_DECAY_MS * 0.001 * sampleRate));
+	}
+
+	void NoiseGate::process(float* audio, uint32_t numSamples) noexcept
+	{
+		if (!enabled)
+			return;
+
+		process_blocks<false>(audio, audio, numSamples, 1);
+	}
+
+	void NoiseGate::process(const float* input, float* output, uint32_t numSamples, float inputGain) noexcept
+	{
+		if (!enabled)
+		{
+			for (uint32_t i = 0; i < numSamples; i++)
+			{
+				output[i] = input[i] * inputGain;
+			}
+
+			return;
+		}
+
+		process_blocks<true>(input, output, numSamples, inputGain);
+	}
+
+	template <bool APPLY_INPUT_GAIN>
+	void NoiseGate::process_blocks(const float* input, float* output, uint32_t numSamples, float inputGain) noexcept
+	{
+		for (uint32_t offset = 0; offset < numSamples; offset += DETECT_BLOCK_SIZE)
+		{
+			uint32_t blockSize = std::min(DETECT_BLOCK_SIZE, numSamples - offset);
+
+			const float* in = input + offset;
+			float* out = output + offset;
+
+			float peak = 0;
+
+			for (uint32_t i = 0; i < blockSize; i++)
+			{
+				peak = std::max(peak, fabsf(in[i]));
+			}
+
+			if constexpr (APPLY_INPUT_GAIN)
+				peak *= fabsf(inputGain);
+
+			envelope = std::max(peak, envelope * envelopeDecay);
+
+			if (envelope >= openThreshold)
+			{
+				open = true;
+				holdRemaining = holdSamples;
+			}
+			else if (open)
+			{
+				if (envelope >= closeThreshold)
+				{
+					holdRemaining = holdSamples;
+				}
+				else if (holdRemaining > blockSize)
+				{
+					holdRemaining -= blockSize;
+				}
+				else
+				{
+					holdRemaining = 0;
+					open = false;
+				}
+			}
+
+			float target = open ? 1.0f : 0.0f;
+
+			if (gain == target)
+			{
+				if (gain == 0)
+				{
+					std::fill(out, out + blockSize, 0.0f);
+
+					// cap well below overflow - callers only compare against receptive field sizes
+					closedSamples = std::min(closedSamples + blockSize, std::numeric_limits<uint32_t>::max() / 2);
+				}
+				else
+				{
+					closedSamples = 0;
+
+					if constexpr (APPLY_INPUT_GAIN)
+					{
+						for (uint32_t i = 0; i < blockSize; i++)
+						{
+							out[i] = in[i] * inputGain;
+						}
+					}
+				}
+
+				continue;
+			}
+
+			closedSamples = 0;
+
+			if (open)
+			{
+				for (uint32_t i = 0; i < blockSize; i++)
+				{
+					gain = std::min(gain + attackStep, 1.0f);
+
+					if constexpr (APPLY_INPUT_GAIN)
+						out[i] = in[i] * inputGain * gain;
+					else
+						out[i] *= gain;
+				}
+			}
+			else
+			{
+				for (uint32_t i = 0; i < blockSize; i++)
+				{
+					gain = std::max(gain - releaseStep, 0.0f);
+
+					if constexpr (APPLY_INPUT_GAIN)
+						out[i] = in[i] * inputGain * gain;
+					else
+						out[i] *= gain;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+namespace NAM {
+	// Noise gate applied to the model input.
+	//
+	// The envelope is followed per DETECT_BLOCK_SIZE samples (a vectorizable peak over the block),
+	// and gate state changes happen on those boundaries. The gate opens when the envelope rises
+	// above the threshold and closes once it has been below (threshold - hysteresis) for the hold time,
+	// fading out over the release time.
+	class NoiseGate {
+	public:
+		// A threshold at or below this disables the gate
+		static constexpr float OFF_DB = -100;
+
+		void set_sample_rate(double rate) noexcept;
+		void set_parameters(float thresholdDB, float hysteresisDB, float holdMS, float releaseMS) noexcept;
+
+		bool is_enabled() const noexcept { return enabled; }
+
+		// The gate always detects on the signal it gates - the model input, after the input gain.
+
+		// Detects on and gates audio in place
+		void process(float* audio, uint32_t numSamples) noexcept;
+
+		// Writes input * inputGain * the gate gain to output, detecting on input * inputGain, so a steady
+		// input gain doesn't need a pass of its own. Can be used in-place.
+		void process(const float* input, float* output, uint32_t numSamples, float inputGain) noexcept;
+
+		// Number of most recent consecutive samples the gate has fully muted
+		uint32_t get_closed_samples() const noexcept { return closedSamples; }
+
+	private:
+		static constexpr uint32_t DETECT_BLOCK_SIZE = 16;
+		static constexpr float ATTACK_MS = 1;
+		static constexpr float ENVELOPE_DECAY_MS = 10;
+
+		void update_coefficients() noexcept;
+
+		template <bool APPLY_INPUT_GAIN>
+		void process_blocks(const float* input, float* output, uint32_t numSamples, float inputGain) noexcept;
+
+		double sampleRate = 48000;
+
+		float thresholdDB = OFF_DB;
+		float hysteresisDB = 0;
+		float holdMS = 0;
+		float releaseMS = 0;
+
+		bool enabled = false;
+		float openThreshold = 0;
+		float closeThreshold = 0;
+		uint32_t holdSamples = 0;
+		float attackStep = 1;
+		float releaseStep = 1;
+		float envelopeDecay = 0;
+
+		float envelope = 0;
+		float gain = 1;
+		bool open = true;
+		uint32_t holdRemaining = 0;
+		uint32_t closedSamples = 0;
+	};
+}
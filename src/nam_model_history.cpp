@@ -0,0 +1,27 @@
+#include <algorithm>
+#include <vector>
+
+#include "nam_model_history.h"
+
+namespace NAM {
+	void reset_model_history(NeuralAudio::NeuralModel* model, int maxBufferSize)
+	{
+		int historySamples = model->GetReceptiveFieldSize();
+
+		if (historySamples < 0)
+			historySamples = DEFAULT_HISTORY_SAMPLES;
+
+		std::vector<float> silence((size_t)std::max(maxBufferSize, 1));
+
+		while (historySamples > 0)
+		{
+			int numSamples = std::min(historySamples, (int)silence.size());
+
+			std::fill(silence.begin(), silence.end(), 0.0f);
+
+			model->Process(silence.data(), silence.data(), numSamples);
+
+			historySamples -= numSamples;
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <NeuralAudio/NeuralModel.h>
+
+namespace NAM {
+	// Silence fed to models that don't report a receptive field size (ie: LSTMs). Their state
+	// decays rather than being cleared, and this (~170ms at 48kHz) is well past where it settles.
+	static constexpr int DEFAULT_HISTORY_SAMPLES = 8192;
+
+	// Clears a model's sample history by running silence through it, so a model that has already
+	// processed audio starts like a freshly loaded one. Not real-time safe.
+	void reset_model_history(NeuralAudio::NeuralModel* model, int maxBufferSize);
+}
@@ -12,10 +12,45 @@
 #endif
 
 namespace NAM {
-	Plugin::Plugin()
+	// Apply a gain to samples [start, end), smoothing it towards desiredLevel. Returns the gain reached.
+	static float apply_gain(const float* input, float* output, uint32_t start, uint32_t end, float level, float desiredLevel) noexcept
+	{
+		if (fabs(desiredLevel - level) > SMOOTH_EPSILON)
+		{
+			for (uint32_t i = start; i < end; i++)
+			{
+				// do very basic smoothing
+				level = (.99f * level) + (.01f * desiredLevel);
+
+				output[i] = input[i] * level;
+			}
+
+			return level;
+		}
+
+		// unity gain is the common case, so skip the pass entirely
+		if (desiredLevel == 1.0f)
+		{
+			if (output != input)
+				std::copy(input + start, input + end, output + start);
+		}
+		else
+		{
+			for (uint32_t i = start; i < end; i++)
+			{
+				output[i] = input[i] * desiredLevel;
+			}
+		}
+
+		return desiredLevel;
+	}
+
+	Plugin::Plugin() :
+		prefetchCache((size_t)PREFETCH_MEMORY_BUDGET_MB * 1024 * 1024)
 	{
 		// prevent allocations on the audio thread
 		currentModelPath.reserve(MAX_FILE_NAME + 1);
+		installedModelPath.reserve(MAX_FILE_NAME + 1);
 
 		bypassThresholdLinear = powf(10, BYPASS_DB_THRESHOLD * 0.05f);
 
@@ -47,6 +82,8 @@ namespace NAM {
 
 		loader.SetExternalSampleRate((int)sampleRate);
 
+		gate.set_sample_rate(sampleRate);
+
 		// for fetching initial options, can be null
 		LV2_Options_Option* options = nullptr;
 
@@ -93,6 +130,12 @@ namespace NAM {
 		uris.units_frame = map->map(map->handle, LV2_UNITS__frame);
 
 		uris.model_Path = map->map(map->handle, MODEL_URI);
+		uris.trace_Path = map->map(map->handle, TRACE_URI);
+		uris.prefetch_HitRate = map->map(map->handle, PREFETCH_HIT_RATE_URI);
+		uris.prefetch_Memory = map->map(map->handle, PREFETCH_MEMORY_URI);
+		uris.model_CacheSize = map->map(map->handle, MODEL_CACHE_SIZE_URI);
+		uris.input_Level = map->map(map->handle, INPUT_LEVEL_URI);
+		uris.output_Level = map->map(map->handle, OUTPUT_LEVEL_URI);
 
 		if (options != nullptr)
 			options_set(this, options);
@@ -108,11 +151,21 @@ namespace NAM {
 		{
 			case kWorkTypeLoad:
 			{
+				NAM_TRACE_ZONE("load");
+
 				auto msg = static_cast<const LV2LoadModelMsg*>(data);
 				auto nam = static_cast<NAM::Plugin*>(instance);
 
+				if (nam->is_superseded(msg->generation))
+				{
+					// a newer model was requested while this one was queued
+					lv2_log_trace(&nam->logger, "Skipping superseded model: `%s`\n", msg->path);
+
+					return LV2_WORKER_SUCCESS;
+				}
+
 				NeuralAudio::NeuralModel* model = nullptr;
-				LV2SwitchModelMsg response = { kWorkTypeSwitch, {}, {} };
+				LV2SwitchModelMsg response = { kWorkTypeSwitch, msg->generation, {}, {} };
 				LV2_Worker_Status result = LV2_WORKER_SUCCESS;
 
 				try
@@ -130,7 +183,14 @@ namespace NAM {
 					{
 						lv2_log_trace(&nam->logger, "Staging model change: `%s`\n", msg->path);
 
-						model = nam->loader.CreateFromFile(msg->path);
+						model = nam->prefetchCache.take(msg->path, nam->maxBufferSize);
+
+						if (model == nullptr)
+						{
+							NAM_TRACE_ZONE("CreateFromFile");
+
+							model = nam->loader.CreateFromFile(msg->path);
+						}
 					}
 
 					if (model != nullptr)
@@ -144,6 +204,16 @@ namespace NAM {
 				{
 				}
 
+				if (nam->is_superseded(msg->generation))
+				{
+					// a newer model was requested while this one was loading, so don't bother the audio thread with it
+					lv2_log_trace(&nam->logger, "Caching superseded model: `%s`\n", msg->path);
+
+					nam->prefetchCache.add(msg->path, model, nam->maxBufferSize, false);
+
+					return LV2_WORKER_SUCCESS;
+				}
+
 				if (model == nullptr)
 				{
 					response.path[0] = '\0';
@@ -151,19 +221,73 @@ namespace NAM {
 					lv2_log_error(&nam->logger, "Unable to load model from: '%s'\n", msg->path);
 				}
 
+				if (nam->prefetchCache.is_enabled())
+				{
+					response.hasPrefetchStats = true;
+					response.prefetchHitRate = (nam->prefetchCache.get_lookups() > 0) ?
+						((float)nam->prefetchCache.get_hits() / nam->prefetchCache.get_lookups()) : 0;
+					response.prefetchMemory = nam->prefetchCache.get_memory_used();
+				}
+
 				respond(handle, sizeof(response), &response);
 
 				return result;
 			}
 
+			case kWorkTypePrefetch:
+			{
+				auto msg = static_cast<const LV2LoadModelMsg*>(data);
+				auto nam = static_cast<NAM::Plugin*>(instance);
+
+				try
+				{
+					nam->prefetch_neighbours(msg->path, msg->generation);
+				}
+				catch (const std::exception&)
+				{
+					// prefetching is only an optimization - never let it take down the host
+				}
+
+				return LV2_WORKER_SUCCESS;
+			}
+
 			case kWorkTypeFree:
 			{
+				NAM_TRACE_ZONE("free");
+
 				auto msg = static_cast<const LV2FreeModelMsg*>(data);
-				delete msg->model;
+				auto nam = static_cast<NAM::Plugin*>(instance);
+
+				// keep swapped out models around for A/B switching (deletes them if caching is disabled)
+				nam->prefetchCache.add(msg->path, msg->model, nam->maxBufferSize, msg->hasProcessed);
 
 				return LV2_WORKER_SUCCESS;
 			}
 
+			case kWorkTypeSetCacheSize:
+			{
+				auto msg = static_cast<const LV2SetCacheSizeMsg*>(data);
+				auto nam = static_cast<NAM::Plugin*>(instance);
+
+				nam->prefetchCache.set_memory_budget((size_t)msg->sizeMB * 1024 * 1024);
+
+				return LV2_WORKER_SUCCESS;
+			}
+
+			case kWorkTypeDumpTrace:
+			{
+#ifdef TRACING_ENABLED
+				auto msg = static_cast<const LV2DumpTraceMsg*>(data);
+				auto nam = static_cast<NAM::Plugin*>(instance);
+
+				if (NAM::Trace::write_chrome_trace(msg->path))
+					lv2_log_note(&nam->logger, "Wrote trace to: '%s'\n", msg->path);
+				else
+					lv2_log_error(&nam->logger, "Unable to write trace to: '%s'\n", msg->path);
+#endif
+				return LV2_WORKER_SUCCESS;
+			}
+
 			case kWorkTypeSwitch:
 				// should not happen!
 				break;
@@ -178,16 +302,32 @@ namespace NAM {
 		if (*(const LV2WorkType*)data != kWorkTypeSwitch)
 			return LV2_WORKER_ERR_UNKNOWN;
 
+		NAM_TRACE_ZONE("swap");
+
 		auto msg = static_cast<const LV2SwitchModelMsg*>(data);
 		auto nam = static_cast<NAM::Plugin*>(instance);
 
+		if (nam->is_superseded(msg->generation))
+		{
+			// superseded after the worker finished loading it - free it instead of installing it
+			LV2FreeModelMsg reply = { kWorkTypeFree, msg->model, {}, false };
+			memcpy(reply.path, msg->path, MAX_FILE_NAME);
+
+			nam->schedule->schedule_work(nam->schedule->handle, sizeof(reply), &reply);
+
+			return LV2_WORKER_SUCCESS;
+		}
+
 		// prepare reply for deleting old model
-		LV2FreeModelMsg reply = { kWorkTypeFree, nam->currentModel };
+		LV2FreeModelMsg reply = { kWorkTypeFree, nam->currentModel, {}, true };
+		memcpy(reply.path, nam->installedModelPath.c_str(), std::min(nam->installedModelPath.length(), (size_t)MAX_FILE_NAME - 1));
 
 		// swap current model with new one
 		nam->currentModel = msg->model;
 		nam->currentModelPath = msg->path;
+		nam->installedModelPath = msg->path;
 		assert(nam->currentModelPath.capacity() >= MAX_FILE_NAME + 1);
+		assert(nam->installedModelPath.capacity() >= MAX_FILE_NAME + 1);
 
 		if (nam->currentModel != nullptr)
 		{
@@ -201,12 +341,27 @@ namespace NAM {
 			}
 		}
 
+		// the new model hasn't seen any of the gated silence yet
+		nam->modelGatedSamples = 0;
+
 		// send reply
 		nam->schedule->schedule_work(nam->schedule->handle, sizeof(reply), &reply);
 
+		if (msg->hasPrefetchStats && (msg->model != nullptr))
+		{
+			// queued after the free, so the model we just swapped out is already cached and doesn't get loaded again
+			LV2LoadModelMsg prefetch = { kWorkTypePrefetch, msg->generation, {} };
+			memcpy(prefetch.path, msg->path, MAX_FILE_NAME);
+
+			nam->schedule->schedule_work(nam->schedule->handle, sizeof(prefetch), &prefetch);
+		}
+
 		// report change to host/ui
 		nam->write_current_path();
 
+		if (msg->hasPrefetchStats)
+			nam->write_prefetch_stats(msg->prefetchHitRate, msg->prefetchMemory);
+
 		return LV2_WORKER_SUCCESS;
 	}
 
@@ -219,6 +374,8 @@ namespace NAM {
 
 	void Plugin::process(uint32_t n_samples) noexcept
 	{
+		NAM_TRACE_ZONE("process");
+
 		lv2_atom_forge_set_buffer(&atom_forge, (uint8_t*)ports.notify, ports.notify->atom.size);
 		lv2_atom_forge_sequence_head(&atom_forge, &sequence_frame, uris.units_frame);
 
@@ -228,6 +385,32 @@ namespace NAM {
 			loader.SetDefaultQualityScaleFactor(*(ports.quality_scale));
 		}
 
+		// level port changes apply from the start of the block, timestamped level events from their frame
+		const float previousInputLevelDB = inputLevelDB;
+		const float previousOutputLevelDB = outputLevelDB;
+
+		if (*(ports.input_level) != inputLevelPort)
+			inputLevelDB = inputLevelPort = *(ports.input_level);
+
+		if (*(ports.output_level) != outputLevelPort)
+			outputLevelDB = outputLevelPort = *(ports.output_level);
+
+		bool levelsChanged = (inputLevelDB != previousInputLevelDB) || (outputLevelDB != previousOutputLevelDB);
+
+		// levels from restore() hold until the next event or control port change
+		uint32_t restoredLevels = restoredLevelMask.exchange(0, std::memory_order_acquire);
+
+		if (restoredLevels & RESTORED_INPUT_LEVEL)
+			inputLevelDB = restoredInputLevelDB;
+
+		if (restoredLevels & RESTORED_OUTPUT_LEVEL)
+			outputLevelDB = restoredOutputLevelDB;
+
+		levelsChanged |= (restoredLevels != 0);
+
+		levelSegments[0] = { 0, inputLevelDB, outputLevelDB };
+		numLevelSegments = 1;
+
 		LV2_ATOM_SEQUENCE_FOREACH(ports.control, event)
 		{
 			if (event->body.type == uris.atom_Object)
@@ -236,6 +419,7 @@ namespace NAM {
 				if (obj->body.otype == uris.patch_Get)
 				{
 					write_current_path();
+					write_levels();
 				}
 				else if (obj->body.otype == uris.patch_Set)
 				{
@@ -248,19 +432,50 @@ namespace NAM {
 					                    0);
 
 					if (property && property->type == uris.atom_URID &&
+						(((const LV2_Atom_URID*)property)->body == uris.input_Level ||
+						((const LV2_Atom_URID*)property)->body == uris.output_Level) &&
+						file_path && file_path->type == uris.atom_Float)
+					{
+						add_level_event(std::min((uint32_t)event->time.frames, n_samples), ((const LV2_Atom_URID*)property)->body == uris.output_Level,
+							((const LV2_Atom_Float*)file_path)->body);
+
+						levelsChanged = true;
+					}
+					else if (property && property->type == uris.atom_URID &&
+						((const LV2_Atom_URID*)property)->body == uris.model_CacheSize &&
+						file_path && file_path->type == uris.atom_Int)
+					{
+						set_model_cache_size(((const LV2_Atom_Int*)file_path)->body);
+					}
+					else if (property && property->type == uris.atom_URID &&
 						((const LV2_Atom_URID*)property)->body == uris.model_Path &&
 						file_path && file_path->type == uris.atom_Path &&
 						file_path->size > 0 && file_path->size < MAX_FILE_NAME)
 					{
-						LV2LoadModelMsg msg = { kWorkTypeLoad, {} };
+						LV2LoadModelMsg msg = { kWorkTypeLoad, next_load_generation(), {} };
 						memcpy(msg.path, file_path + 1, file_path->size);
 						schedule->schedule_work(schedule->handle, sizeof(msg), &msg);
 					}
+#ifdef TRACING_ENABLED
+					else if (property && property->type == uris.atom_URID &&
+						((const LV2_Atom_URID*)property)->body == uris.trace_Path &&
+						file_path && file_path->type == uris.atom_Path &&
+						file_path->size > 0 && file_path->size < MAX_FILE_NAME)
+					{
+						LV2DumpTraceMsg msg = { kWorkTypeDumpTrace, {} };
+						memcpy(msg.path, file_path + 1, file_path->size);
+						schedule->schedule_work(schedule->handle, sizeof(msg), &msg);
+					}
+#endif
 				}
 			}
 		}
 
-		float level;
+		inputLevelDB = levelSegments[numLevelSegments - 1].inputDB;
+		outputLevelDB = levelSegments[numLevelSegments - 1].outputDB;
+
+		if (levelsChanged)
+			write_levels();
 
 		float modelInputAdjustmentDB = 0;
 
@@ -312,68 +527,112 @@ namespace NAM {
 #endif
 		}
 
-		// convert input level from db
-		float desiredInputLevel = powf(10, (*(ports.input_level) + modelInputAdjustmentDB) * 0.05f);
+		gate.set_parameters(*(ports.gate_threshold), *(ports.gate_hysteresis), *(ports.gate_hold), *(ports.gate_release));
+
+		NAM_TRACE_BEGIN(inputGain);
 
-		if (fabs(desiredInputLevel - inputLevel) > SMOOTH_EPSILON)
+		float modelLoudnessAdjustmentDB = (currentModel != nullptr) ? currentModel->GetRecommendedOutputDBAdjustment() : 0;
+
+		// nothing in between the two gain stages without a model (or gate), so do both in one pass
+		bool fuseGain = (currentModel == nullptr) && !gate.is_enabled();
+
+		// with the gate on, an input gain that is steady for the whole block is applied in the gate's pass
+		bool gateCanApplyGain = (numLevelSegments == 1) && gate.is_enabled();
+		bool gainInGate = false;
+		float gateInputGain = 1;
+
+		for (uint32_t segment = 0; segment < numLevelSegments; segment++)
 		{
-			level = inputLevel;
-			for (unsigned int i = 0; i < n_samples; i++)
+			uint32_t start = levelSegments[segment].start;
+			uint32_t end = ((segment + 1) < numLevelSegments) ? levelSegments[segment + 1].start : n_samples;
+
+			// convert levels from db
+			float desiredInputLevel = powf(10, (levelSegments[segment].inputDB + modelInputAdjustmentDB) * 0.05f);
+
+			if (fuseGain)
 			{
-				// do very basic smoothing
-				level = (.99f * level) + (.01f * desiredInputLevel);
+				float desiredOutputLevel = powf(10, (levelSegments[segment].outputDB + modelLoudnessAdjustmentDB) * 0.05f);
 
-				ports.audio_out[i] = ports.audio_in[i] * level;
-			}
+				if ((fabs(desiredInputLevel - inputLevel) <= SMOOTH_EPSILON) && (fabs(desiredOutputLevel - outputLevel) <= SMOOTH_EPSILON))
+				{
+					apply_gain(ports.audio_in, ports.audio_out, start, end, desiredInputLevel * desiredOutputLevel,
+						desiredInputLevel * desiredOutputLevel);
 
-			inputLevel = level;
-		}
-		else
-		{
-			level = inputLevel = desiredInputLevel;
+					inputLevel = desiredInputLevel;
+					outputLevel = desiredOutputLevel;
 
-			for (unsigned int i = 0; i < n_samples; i++)
+					continue;
+				}
+
+				inputLevel = apply_gain(ports.audio_in, ports.audio_out, start, end, inputLevel, desiredInputLevel);
+				outputLevel = apply_gain(ports.audio_out, ports.audio_out, start, end, outputLevel, desiredOutputLevel);
+			}
+			else if (gateCanApplyGain && (fabs(desiredInputLevel - inputLevel) <= SMOOTH_EPSILON))
 			{
-				ports.audio_out[i] = ports.audio_in[i] * level;
+				inputLevel = gateInputGain = desiredInputLevel;
+				gainInGate = true;
+			}
+			else
+			{
+				inputLevel = apply_gain(ports.audio_in, ports.audio_out, start, end, inputLevel, desiredInputLevel);
 			}
 		}
 
-		float modelLoudnessAdjustmentDB = 0;
+		NAM_TRACE_END(inputGain, "input gain");
 
-		if (currentModel != nullptr)
-		{
-			currentModel->Process(ports.audio_out, ports.audio_out, n_samples);
+		NAM_TRACE_BEGIN(gate);
 
-			modelLoudnessAdjustmentDB = currentModel->GetRecommendedOutputDBAdjustment();
-		}
+		// either way the gate detects on the input after the input gain, whether or not the host
+		// processes in place
+		if (gainInGate)
+			gate.process(ports.audio_in, ports.audio_out, n_samples, gateInputGain);
+		else
+			gate.process(ports.audio_out, n_samples);
 
-		// Convert output level from db
-		float desiredOutputLevel = powf(10, (*(ports.output_level) + modelLoudnessAdjustmentDB) * 0.05f);
+		NAM_TRACE_END(gate, "gate");
 
-		if (fabs(desiredOutputLevel - outputLevel) > SMOOTH_EPSILON)
+		if (currentModel != nullptr)
 		{
-			level = outputLevel;
+			int receptiveFieldSamples = currentModel->GetReceptiveFieldSize();
+			uint32_t gateClosedSamples = gate.get_closed_samples();
 
-			for (unsigned int i = 0; i < n_samples; i++)
+			if ((receptiveFieldSamples > -1) && (modelGatedSamples >= (uint32_t)receptiveFieldSamples) && (gateClosedSamples >= n_samples))
 			{
-				// do very basic smoothing
-				level = (.99f * level) + (.01f * desiredOutputLevel);
-
-				ports.audio_out[i] = ports.audio_out[i] * outputLevel;
+				// The model has already been fed a full receptive field of gated silence, so its history is all
+				// zeros and stays that way while the gate is closed. Skip it and repeat the output it settled on.
+				std::fill(ports.audio_out, ports.audio_out + n_samples, gatedModelOutput);
 			}
+			else
+			{
+				NAM_TRACE_ZONE("model");
+
+				currentModel->Process(ports.audio_out, ports.audio_out, n_samples);
+
+				// count how much trailing silence the model has actually processed
+				modelGatedSamples = (gateClosedSamples >= n_samples) ? (modelGatedSamples + n_samples) : gateClosedSamples;
 
-			outputLevel = level;
+				if (n_samples > 0)
+					gatedModelOutput = ports.audio_out[n_samples - 1];
+			}
 		}
-		else
-		{
-			level = outputLevel = desiredOutputLevel;
 
-			for (unsigned int i = 0; i < n_samples; i++)
+		NAM_TRACE_BEGIN(outputGain);
+
+		if (!fuseGain)
+		{
+			for (uint32_t segment = 0; segment < numLevelSegments; segment++)
 			{
-				ports.audio_out[i] = ports.audio_out[i] * level;
+				uint32_t start = levelSegments[segment].start;
+				uint32_t end = ((segment + 1) < numLevelSegments) ? levelSegments[segment + 1].start : n_samples;
+
+				float desiredOutputLevel = powf(10, (levelSegments[segment].outputDB + modelLoudnessAdjustmentDB) * 0.05f);
+
+				outputLevel = apply_gain(ports.audio_out, ports.audio_out, start, end, outputLevel, desiredOutputLevel);
 			}
 		}
 
+		NAM_TRACE_END(outputGain, "output gain");
+
 		//float dcBlockCoefficient = 1 - (220.0 / sampleRate);
 
 		//for (unsigned int i = 0; i < n_samples; i++)
@@ -388,6 +647,42 @@ namespace NAM {
 		//}
 	}
 
+	void Plugin::add_level_event(uint32_t frame, bool output, float levelDB) noexcept
+	{
+		if (std::isnan(levelDB))
+			return;
+
+		// events aren't bounded by the port range like control port values are
+		levelDB = std::clamp(levelDB, LEVEL_MIN_DB, LEVEL_MAX_DB);
+
+		LevelSegment& last = levelSegments[numLevelSegments - 1];
+
+		// start a new segment unless the event lands on the current one, or we have run out of them
+		if ((frame > last.start) && (numLevelSegments < MAX_LEVEL_SEGMENTS))
+		{
+			levelSegments[numLevelSegments++] = { frame, last.inputDB, last.outputDB };
+		}
+
+		if (output)
+			levelSegments[numLevelSegments - 1].outputDB = levelDB;
+		else
+			levelSegments[numLevelSegments - 1].inputDB = levelDB;
+	}
+
+	void Plugin::set_model_cache_size(int32_t sizeMB) noexcept
+	{
+		sizeMB = std::clamp(sizeMB, 0, MAX_MODEL_CACHE_SIZE_MB);
+
+		if (sizeMB == modelCacheSizeMB)
+			return;
+
+		modelCacheSizeMB = sizeMB;
+
+		// the cache belongs to the worker
+		LV2SetCacheSizeMsg msg = { kWorkTypeSetCacheSize, sizeMB };
+		schedule->schedule_work(schedule->handle, sizeof(msg), &msg);
+	}
+
 	uint32_t Plugin::options_get(LV2_Handle, LV2_Options_Option*)
 	{
 		// currently unused
@@ -417,6 +712,15 @@ namespace NAM {
 
 		lv2_log_trace(&nam->logger, "Saving state\n");
 
+		store(handle, nam->uris.model_CacheSize, &nam->modelCacheSizeMB, sizeof(int32_t), nam->uris.atom_Int,
+			LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+
+		store(handle, nam->uris.input_Level, &nam->inputLevelDB, sizeof(float), nam->uris.atom_Float,
+			LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+
+		store(handle, nam->uris.output_Level, &nam->outputLevelDB, sizeof(float), nam->uris.atom_Float,
+			LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+
 		if (!nam->currentModel)
 		{
 			return LV2_STATE_SUCCESS;
@@ -456,17 +760,48 @@ namespace NAM {
 	LV2_State_Status Plugin::restore(LV2_Handle instance, LV2_State_Retrieve_Function retrieve, LV2_State_Handle handle, 
 		uint32_t flags, const LV2_Feature* const* features)
 	{
+		NAM_TRACE_ZONE("restore");
+
 		auto nam = static_cast<NAM::Plugin*>(instance);
 
-		// Get model_Path from state
 		size_t      size     = 0;
 		uint32_t    type     = 0;
 		uint32_t    valflags = 0;
-		const void* value = retrieve(handle, nam->uris.model_Path, &size, &type, &valflags);
+
+		// Set the cache size first, so the model load below prefetches (or not) accordingly
+		const void* value = retrieve(handle, nam->uris.model_CacheSize, &size, &type, &valflags);
+
+		if (value && (type == nam->uris.atom_Int) && (size == sizeof(int32_t)))
+			nam->set_model_cache_size(*(const int32_t*)value);
+
+		// Levels are picked up by the next process() call, which may be running concurrently
+		uint32_t restoredLevels = 0;
+
+		value = retrieve(handle, nam->uris.input_Level, &size, &type, &valflags);
+
+		if (value && (type == nam->uris.atom_Float) && (size == sizeof(float)) && !std::isnan(*(const float*)value))
+		{
+			nam->restoredInputLevelDB = std::clamp(*(const float*)value, LEVEL_MIN_DB, LEVEL_MAX_DB);
+			restoredLevels |= RESTORED_INPUT_LEVEL;
+		}
+
+		value = retrieve(handle, nam->uris.output_Level, &size, &type, &valflags);
+
+		if (value && (type == nam->uris.atom_Float) && (size == sizeof(float)) && !std::isnan(*(const float*)value))
+		{
+			nam->restoredOutputLevelDB = std::clamp(*(const float*)value, LEVEL_MIN_DB, LEVEL_MAX_DB);
+			restoredLevels |= RESTORED_OUTPUT_LEVEL;
+		}
+
+		if (restoredLevels != 0)
+			nam->restoredLevelMask.fetch_or(restoredLevels, std::memory_order_release);
+
+		// Get model_Path from state
+		value = retrieve(handle, nam->uris.model_Path, &size, &type, &valflags);
 
 		lv2_log_trace(&nam->logger, "Restoring model '%s'\n", (const char*)value);
 
-		NAM::LV2LoadModelMsg msg = { NAM::kWorkTypeLoad, {} };
+		NAM::LV2LoadModelMsg msg = { NAM::kWorkTypeLoad, 0, {} };
 
 		LV2_State_Status result = LV2_STATE_SUCCESS;
 
@@ -519,6 +854,8 @@ namespace NAM {
 		if (result == LV2_STATE_SUCCESS)
 		{
 			// Schedule model to be loaded by the provided worker
+			msg.generation = nam->next_load_generation();
+
 			nam->schedule->schedule_work(nam->schedule->handle, sizeof(msg), &msg);
 
 			nam->currentModelPath = msg.path;
@@ -541,4 +878,88 @@ namespace NAM {
 
 		lv2_atom_forge_pop(&atom_forge, &frame);
 	}
+
+	void Plugin::write_levels()
+	{
+		LV2_Atom_Forge_Frame frame;
+
+		lv2_atom_forge_frame_time(&atom_forge, 0);
+		lv2_atom_forge_object(&atom_forge, &frame, 0, uris.patch_Set);
+
+		lv2_atom_forge_key(&atom_forge, uris.patch_property);
+		lv2_atom_forge_urid(&atom_forge, uris.input_Level);
+		lv2_atom_forge_key(&atom_forge, uris.patch_value);
+		lv2_atom_forge_float(&atom_forge, inputLevelDB);
+
+		lv2_atom_forge_pop(&atom_forge, &frame);
+
+		lv2_atom_forge_frame_time(&atom_forge, 0);
+		lv2_atom_forge_object(&atom_forge, &frame, 0, uris.patch_Set);
+
+		lv2_atom_forge_key(&atom_forge, uris.patch_property);
+		lv2_atom_forge_urid(&atom_forge, uris.output_Level);
+		lv2_atom_forge_key(&atom_forge, uris.patch_value);
+		lv2_atom_forge_float(&atom_forge, outputLevelDB);
+
+		lv2_atom_forge_pop(&atom_forge, &frame);
+	}
+
+	void Plugin::write_prefetch_stats(float hitRate, uint64_t memory)
+	{
+		LV2_Atom_Forge_Frame frame;
+
+		lv2_atom_forge_frame_time(&atom_forge, 0);
+		lv2_atom_forge_object(&atom_forge, &frame, 0, uris.patch_Set);
+
+		lv2_atom_forge_key(&atom_forge, uris.patch_property);
+		lv2_atom_forge_urid(&atom_forge, uris.prefetch_HitRate);
+		lv2_atom_forge_key(&atom_forge, uris.patch_value);
+		lv2_atom_forge_float(&atom_forge, hitRate);
+
+		lv2_atom_forge_pop(&atom_forge, &frame);
+
+		lv2_atom_forge_frame_time(&atom_forge, 0);
+		lv2_atom_forge_object(&atom_forge, &frame, 0, uris.patch_Set);
+
+		lv2_atom_forge_key(&atom_forge, uris.patch_property);
+		lv2_atom_forge_urid(&atom_forge, uris.prefetch_Memory);
+		lv2_atom_forge_key(&atom_forge, uris.patch_value);
+		lv2_atom_forge_long(&atom_forge, (int64_t)memory);
+
+		lv2_atom_forge_pop(&atom_forge, &frame);
+	}
+
+	// runs on the worker, after a model has been loaded
+	void Plugin::prefetch_neighbours(const char* path, uint32_t generation)
+	{
+		if (!prefetchCache.is_enabled())
+			return;
+
+		NAM_TRACE_ZONE("prefetch");
+
+		for (const auto& neighbour : ModelPrefetchCache::find_neighbours(path))
+		{
+			// stop as soon as the user moves on - their request is queued behind us
+			if (is_superseded(generation))
+				return;
+
+			if (prefetchCache.contains(neighbour))
+				continue;
+
+			NeuralAudio::NeuralModel* model = nullptr;
+
+			try
+			{
+				model = loader.CreateFromFile(neighbour);
+			}
+			catch (const std::exception&)
+			{
+			}
+
+			prefetchCache.add(neighbour.c_str(), model, maxBufferSize, false);
+		}
+
+		lv2_log_note(&logger, "Model cache: %u/%u hits, %.1f MB used\n", prefetchCache.get_hits(), prefetchCache.get_lookups(),
+			prefetchCache.get_memory_used() / (1024.0 * 1024.0));
+	}
 }
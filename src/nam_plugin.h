@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cfloat>
 #include <cstddef>
 #include <cstdint>
 #include <random>
@@ -23,8 +25,31 @@
 
 #include <NeuralAudio/NeuralModel.h>
 
+#include "nam_gate.h"
+#include "nam_prefetch.h"
+#include "nam_trace.h"
+
 #define PlUGIN_URI "http://github.com/mikeoliphant/neural-amp-modeler-lv2"
 #define MODEL_URI PlUGIN_URI "#model"
+#define TRACE_URI PlUGIN_URI "#traceFile"
+#define PREFETCH_HIT_RATE_URI PlUGIN_URI "#prefetchHitRate"
+#define PREFETCH_MEMORY_URI PlUGIN_URI "#prefetchMemory"
+#define MODEL_CACHE_SIZE_URI PlUGIN_URI "#modelCacheSize"
+
+#define MAX_MODEL_CACHE_SIZE_MB 1024
+
+// default model cache size - off unless the host/user sets #modelCacheSize
+#ifndef PREFETCH_MEMORY_BUDGET_MB
+#define PREFETCH_MEMORY_BUDGET_MB 0
+#endif
+#define INPUT_LEVEL_URI PlUGIN_URI "#inputLevel"
+#define OUTPUT_LEVEL_URI PlUGIN_URI "#outputLevel"
+
+#define MAX_LEVEL_SEGMENTS 32
+
+// range of the input_level and output_level ports - keep in sync with the ttl
+#define LEVEL_MIN_DB -20.0f
+#define LEVEL_MAX_DB 20.0f
 
 namespace NAM {
 	static constexpr unsigned int MAX_FILE_NAME = 1024;
@@ -32,23 +57,44 @@ namespace NAM {
 	enum LV2WorkType {
 		kWorkTypeLoad,
 		kWorkTypeSwitch,
-		kWorkTypeFree
+		kWorkTypeFree,
+		kWorkTypeDumpTrace,
+		kWorkTypeSetCacheSize,
+		kWorkTypePrefetch
 	};
 
+	// also used for kWorkTypePrefetch, with the path of the model whose neighbours to load
 	struct LV2LoadModelMsg {
 		LV2WorkType type;
+		uint32_t generation;
 		char path[MAX_FILE_NAME];
 	};
 
 	struct LV2SwitchModelMsg {
 		LV2WorkType type;
+		uint32_t generation;
 		char path[MAX_FILE_NAME];
 		NeuralAudio::NeuralModel* model;
+		bool hasPrefetchStats;
+		float prefetchHitRate;
+		uint64_t prefetchMemory;
 	};
 
 	struct LV2FreeModelMsg {
 		LV2WorkType type;
 		NeuralAudio::NeuralModel* model;
+		char path[MAX_FILE_NAME];
+		bool hasProcessed;	// models that have run need their history cleared before being reused
+	};
+
+	struct LV2DumpTraceMsg {
+		LV2WorkType type;
+		char path[MAX_FILE_NAME];
+	};
+
+	struct LV2SetCacheSizeMsg {
+		LV2WorkType type;
+		int32_t sizeMB;
 	};
 
 	class Plugin {
@@ -61,6 +107,10 @@ namespace NAM {
 			float* input_level;
 			float* output_level;
 			float* quality_scale;
+			float* gate_threshold;
+			float* gate_hysteresis;
+			float* gate_hold;
+			float* gate_release;
 		};
 
 		Ports ports = {};
@@ -76,6 +126,12 @@ namespace NAM {
 		std::string currentModelPath;
 		float prevDCInput = 0;
 		float prevDCOutput = 0;
+		NoiseGate gate;
+		ModelPrefetchCache prefetchCache;
+
+		// Bumped for every model request. Loads and switches carrying an older generation have been
+		// superseded (ie: by a user scrolling through a model folder) and are dropped.
+		std::atomic<uint32_t> loadGeneration = 0;
 
 		Plugin();
 		~Plugin();
@@ -86,6 +142,12 @@ namespace NAM {
 		void process(uint32_t n_samples) noexcept;
 
 		void write_current_path();
+		void write_levels();
+		void write_prefetch_stats(float hitRate, uint64_t memory);
+		void prefetch_neighbours(const char* path, uint32_t generation);
+
+		uint32_t next_load_generation() noexcept { return ++loadGeneration; }
+		bool is_superseded(uint32_t generation) const noexcept { return generation != loadGeneration.load(std::memory_order_acquire); }
 
 		static uint32_t options_get(LV2_Handle instance, LV2_Options_Option* options);
 		static uint32_t options_set(LV2_Handle instance, const LV2_Options_Option* options);
@@ -113,18 +175,52 @@ namespace NAM {
 			LV2_URID patch_value;
 			LV2_URID units_frame;
 			LV2_URID model_Path;
+			LV2_URID trace_Path;
+			LV2_URID prefetch_HitRate;
+			LV2_URID prefetch_Memory;
+			LV2_URID model_CacheSize;
+			LV2_URID input_Level;
+			LV2_URID output_Level;
+		};
+
+		// Gain targets (in dB) from a frame onwards. Timestamped level changes split the gain passes
+		// into segments, while the model still processes the whole block in a single call.
+		struct LevelSegment {
+			uint32_t start;
+			float inputDB;
+			float outputDB;
 		};
 
 		URIs uris = {};
 
+		void add_level_event(uint32_t frame, bool output, float levelDB) noexcept;
+		void set_model_cache_size(int32_t sizeMB) noexcept;
+
 		LV2_Atom_Forge atom_forge = {};
 		LV2_Atom_Forge_Frame sequence_frame;
 
+		// The file currentModel was loaded from. currentModelPath can run ahead of it (ie: restore() sets it
+		// while the new model is still loading), so the outgoing model is cached under this one.
+		std::string installedModelPath;
 		float inputLevel = 0;
 		float outputLevel = 0;
+		float inputLevelDB = 0;
+		float outputLevelDB = 0;
+		float inputLevelPort = -FLT_MAX;
+		float outputLevelPort = -FLT_MAX;
+		LevelSegment levelSegments[MAX_LEVEL_SEGMENTS];
+		uint32_t numLevelSegments = 0;
+		static constexpr uint32_t RESTORED_INPUT_LEVEL = 1;
+		static constexpr uint32_t RESTORED_OUTPUT_LEVEL = 2;
+		float restoredInputLevelDB = 0;
+		float restoredOutputLevelDB = 0;
+		std::atomic<uint32_t> restoredLevelMask = 0;
 		int32_t maxBufferSize = 512;
+		int32_t modelCacheSizeMB = PREFETCH_MEMORY_BUDGET_MB;
 		float bypassThresholdLinear = 0;
 		uint32_t silentSamples = 0;
 		bool smartBypassed = true;
+		uint32_t modelGatedSamples = 0;
+		float gatedModelOutput = 0;
 	};
 }
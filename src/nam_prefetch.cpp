@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <system_error>
+
+#include "nam_model_history.h"
+#include "nam_prefetch.h"
+
+namespace NAM {
+	// keep in sync with mod:fileTypes in the ttl
+	static constexpr std::array<const char*, 5> MODEL_EXTENSIONS = { ".nam", ".nammodel", ".json", ".aidax", ".aidadspmodel" };
+
+	static bool is_model_file(const std::filesystem::path& path)
+	{
+		std::string extension = path.extension().string();
+
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+		return std::find(MODEL_EXTENSIONS.begin(), MODEL_EXTENSIONS.end(), extension) != MODEL_EXTENSIONS.end();
+	}
+
+	ModelPrefetchCache::ModelPrefetchCache(size_t memoryBudget) :
+		memoryBudget(memoryBudget)
+	{
+	}
+
+	ModelPrefetchCache::~ModelPrefetchCache()
+	{
+		for (auto& entry : entries)
+			delete entry.model;
+	}
+
+	void ModelPrefetchCache::set_memory_budget(size_t budget)
+	{
+		memoryBudget = budget;
+
+		evict(0);
+	}
+
+	NeuralAudio::NeuralModel* ModelPrefetchCache::take(const char* path, int maxBufferSize)
+	{
+		if (!is_enabled())
+			return nullptr;
+
+		lookups++;
+
+		auto found = std::find_if(entries.begin(), entries.end(), [path](const Entry& entry) { return entry.path == path; });
+
+		if (found == entries.end())
+			return nullptr;
+
+		NeuralAudio::NeuralModel* model = found->model;
+
+		std::error_code error;
+		auto modified = std::filesystem::last_write_time(path, error);
+
+		memoryUsed -= found->size;
+
+		if (error || (modified != found->modified) || (found->maxBufferSize != maxBufferSize))
+		{
+			// stale - the caller will load it again
+			delete model;
+
+			model = nullptr;
+		}
+		else
+		{
+			hits++;
+		}
+
+		entries.erase(found);
+
+		return model;
+	}
+
+	void ModelPrefetchCache::add(const char* path, NeuralAudio::NeuralModel* model, int maxBufferSize, bool resetHistory)
+	{
+		if (model == nullptr)
+			return;
+
+		std::error_code error;
+		size_t size = (size_t)std::filesystem::file_size(path, error);
+		auto modified = std::filesystem::last_write_time(path, error);
+
+		if (!is_enabled() || error || (size > memoryBudget))
+		{
+			delete model;
+
+			return;
+		}
+
+		if (resetHistory)
+			reset_model_history(model, maxBufferSize);
+
+		auto existing = std::find_if(entries.begin(), entries.end(), [path](const Entry& entry) { return entry.path == path; });
+
+		if (existing != entries.end())
+		{
+			// replace the existing copy rather than trusting it - the newer one matches the file as it is now
+			memoryUsed -= existing->size;
+
+			delete existing->model;
+			entries.erase(existing);
+		}
+
+		evict(size);
+
+		entries.push_front({ path, model, size, modified, maxBufferSize });
+		memoryUsed += size;
+	}
+
+	bool ModelPrefetchCache::contains(const std::string& path) const
+	{
+		return std::any_of(entries.begin(), entries.end(), [&path](const Entry& entry) { return entry.path == path; });
+	}
+
+	std::vector<std::string> ModelPrefetchCache::find_neighbours(const char* path)
+	{
+		std::vector<std::string> neighbours;
+
+		std::filesystem::path modelPath(path);
+		std::vector<std::filesystem::path> files;
+
+		std::error_code error;
+
+		// advance with increment(error) - operator++ (as used by range-for) throws on errors
+		for (std::filesystem::directory_iterator file(modelPath.parent_path(), error), end; !error && (file != end); file.increment(error))
+		{
+			if (file->is_regular_file(error) && is_model_file(file->path()))
+				files.push_back(file->path());
+		}
+
+		std::sort(files.begin(), files.end());
+
+		auto current = std::find(files.begin(), files.end(), modelPath);
+
+		if (current == files.end())
+			return neighbours;
+
+		if ((current + 1) != files.end())
+			neighbours.push_back((current + 1)->string());
+
+		if (current != files.begin())
+			neighbours.push_back((current - 1)->string());
+
+		return neighbours;
+	}
+
+	void ModelPrefetchCache::evict(size_t neededSize)
+	{
+		while (!entries.empty() && ((memoryUsed + neededSize) > memoryBudget))
+		{
+			memoryUsed -= entries.back().size;
+
+			delete entries.back().model;
+			entries.pop_back();
+		}
+	}
+}
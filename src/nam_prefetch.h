@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <NeuralAudio/NeuralModel.h>
+
+namespace NAM {
+	// LRU of loaded models that are ready to install, filled by speculatively loading the
+	// neighbours of the current model file and by models that were swapped out or superseded.
+	// Only used from the worker, which LV2 never runs concurrently for one instance.
+	//
+	// Memory use is estimated from model file sizes, which overestimates the in-memory size
+	// of text (JSON) based model formats.
+	class ModelPrefetchCache {
+	public:
+		explicit ModelPrefetchCache(size_t memoryBudget);
+		~ModelPrefetchCache();
+
+		ModelPrefetchCache(const ModelPrefetchCache&) = delete;
+		ModelPrefetchCache& operator=(const ModelPrefetchCache&) = delete;
+
+		bool is_enabled() const noexcept { return memoryBudget > 0; }
+
+		// Evicts models as needed to fit a smaller budget - 0 empties and disables the cache
+		void set_memory_budget(size_t budget);
+
+		// Removes and returns the cached model for path, or returns nullptr.
+		// Models cached from an older file or a different max buffer size are discarded.
+		NeuralAudio::NeuralModel* take(const char* path, int maxBufferSize);
+
+		// Takes ownership of model. Models that have been processing audio need resetHistory
+		// so they start from silence like a freshly loaded one.
+		void add(const char* path, NeuralAudio::NeuralModel* model, int maxBufferSize, bool resetHistory);
+
+		bool contains(const std::string& path) const;
+
+		// Model files before and after path in its directory, sorted by name - next first
+		static std::vector<std::string> find_neighbours(const char* path);
+
+		uint32_t get_hits() const noexcept { return hits; }
+		uint32_t get_lookups() const noexcept { return lookups; }
+		size_t get_memory_used() const noexcept { return memoryUsed; }
+
+	private:
+		struct Entry {
+			std::string path;
+			NeuralAudio::NeuralModel* model;
+			size_t size;
+			std::filesystem::file_time_type modified;
+			int maxBufferSize;
+		};
+
+		void evict(size_t neededSize);
+
+		size_t memoryBudget;
+		size_t memoryUsed = 0;
+
+		// most recently used first
+		std::list<Entry> entries;
+
+		uint32_t hits = 0;
+		uint32_t lookups = 0;
+	};
+}
@@ -0,0 +1,126 @@
+#ifdef TRACING_ENABLED
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "nam_trace.h"
+
+#ifndef TRACE_MAX_THREADS
+#define TRACE_MAX_THREADS 32
+#endif
+
+#ifndef TRACE_EVENTS_PER_THREAD
+#define TRACE_EVENTS_PER_THREAD 8192	// must be a power of two
+#endif
+
+namespace NAM::Trace {
+	static_assert((TRACE_EVENTS_PER_THREAD & (TRACE_EVENTS_PER_THREAD - 1)) == 0, "TRACE_EVENTS_PER_THREAD must be a power of two");
+
+	struct Event {
+		const char* name;
+		uint64_t startNs;
+		uint64_t durationNs;
+	};
+
+	// Single writer (the owning thread), read only by write_chrome_trace()
+	struct ThreadBuffer {
+		std::atomic<uint64_t> writeIndex;
+		Event events[TRACE_EVENTS_PER_THREAD];
+	};
+
+	// Statically allocated so the first zone on a thread (ie: the audio thread) doesn't allocate
+	static ThreadBuffer threadBuffers[TRACE_MAX_THREADS];
+
+	// The thread writing into each buffer. Slots are claimed in order and never released - a thread
+	// reusing an exited thread's id carries on in its buffer. This avoids thread_local, which can
+	// allocate on first access from a thread that existed before the plugin library was loaded.
+	static std::atomic<std::thread::id> bufferOwners[TRACE_MAX_THREADS];
+
+	static ThreadBuffer* find_thread_buffer() noexcept
+	{
+		const std::thread::id self = std::this_thread::get_id();
+
+		for (uint32_t slot = 0; slot < TRACE_MAX_THREADS; slot++)
+		{
+			std::thread::id owner = bufferOwners[slot].load(std::memory_order_acquire);
+
+			if (owner == self)
+				return &threadBuffers[slot];
+
+			if ((owner == std::thread::id()) &&
+				bufferOwners[slot].compare_exchange_strong(owner, self, std::memory_order_acq_rel))
+				return &threadBuffers[slot];
+		}
+
+		return nullptr;
+	}
+
+	uint64_t now_ns() noexcept
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void record(const char* name, uint64_t startNs, uint64_t endNs) noexcept
+	{
+		ThreadBuffer* buffer = find_thread_buffer();
+
+		if (buffer == nullptr)
+			return;
+
+		uint64_t writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+
+		buffer->events[writeIndex & (TRACE_EVENTS_PER_THREAD - 1)] = { name, startNs, endNs - startNs };
+
+		buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
+	}
+
+	bool write_chrome_trace(const char* path)
+	{
+		FILE* file = fopen(path, "w");
+
+		if (file == nullptr)
+			return false;
+
+		fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+		bool first = true;
+
+		for (uint32_t thread = 0; thread < TRACE_MAX_THREADS; thread++)
+		{
+			if (bufferOwners[thread].load(std::memory_order_acquire) == std::thread::id())
+				break;
+
+			ThreadBuffer& buffer = threadBuffers[thread];
+
+			uint64_t end = buffer.writeIndex.load(std::memory_order_acquire);
+			uint64_t start = (end > TRACE_EVENTS_PER_THREAD) ? (end - TRACE_EVENTS_PER_THREAD) : 0;
+
+			for (uint64_t i = start; i < end; i++)
+			{
+				Event event = buffer.events[i & (TRACE_EVENTS_PER_THREAD - 1)];
+
+				// keep the slot read above from moving past the index check below
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				// the writer may have lapped us while we were reading this slot - once it is writing
+				// event i + TRACE_EVENTS_PER_THREAD, the slot may hold a half written event
+				if ((buffer.writeIndex.load(std::memory_order_relaxed) - i) >= TRACE_EVENTS_PER_THREAD)
+					continue;
+
+				fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",", event.name, thread, event.startNs / 1000.0, event.durationNs / 1000.0);
+
+				first = false;
+			}
+		}
+
+		fprintf(file, "\n]}\n");
+
+		return fclose(file) == 0;
+	}
+}
+
+#endif
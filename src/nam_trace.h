@@ -0,0 +1,58 @@
+#pragma once
+
+// Low-overhead trace zones, compiled in with -DTRACING_ENABLED=ON.
+//
+// NAM_TRACE_ZONE("name") records the time from that point to the end of the enclosing scope.
+// NAM_TRACE_BEGIN(id)/NAM_TRACE_END(id, "name") do the same for a span that isn't its own scope.
+// Names must be string literals - only the pointer is stored. Each thread writes into its own
+// fixed-size ring buffer without locking or allocating, so zones are safe on the audio thread.
+// write_chrome_trace() dumps all buffers as Chrome/Perfetto trace JSON.
+//
+// Without TRACING_ENABLED the macros expand to nothing.
+
+#ifdef TRACING_ENABLED
+
+#include <cstdint>
+
+namespace NAM::Trace {
+	uint64_t now_ns() noexcept;
+	void record(const char* name, uint64_t startNs, uint64_t endNs) noexcept;
+
+	// Non-RT. Events overwritten while the dump is running are dropped.
+	bool write_chrome_trace(const char* path);
+
+	class Zone {
+	public:
+		explicit Zone(const char* name) noexcept :
+			name(name),
+			startNs(now_ns())
+		{
+		}
+
+		~Zone()
+		{
+			record(name, startNs, now_ns());
+		}
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t startNs;
+	};
+}
+
+#define NAM_TRACE_CONCAT_(a, b) a##b
+#define NAM_TRACE_CONCAT(a, b) NAM_TRACE_CONCAT_(a, b)
+#define NAM_TRACE_ZONE(name) NAM::Trace::Zone NAM_TRACE_CONCAT(traceZone, __LINE__)(name)
+#define NAM_TRACE_BEGIN(id) const uint64_t NAM_TRACE_CONCAT(traceStart_, id) = NAM::Trace::now_ns()
+#define NAM_TRACE_END(id, name) NAM::Trace::record(name, NAM_TRACE_CONCAT(traceStart_, id), NAM::Trace::now_ns())
+
+#else
+
+#define NAM_TRACE_ZONE(name)
+#define NAM_TRACE_BEGIN(id)
+#define NAM_TRACE_END(id, name)
+
+#endif
@@ -0,0 +1,266 @@
+// Local test client for nam_server. Streams a raw 32-bit float mono file through one
+// or more concurrent server streams and writes the first stream's output.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "nam_stream_protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct StreamResult {
+	bool ok = false;
+	double latencyMsTotal = 0;
+	double latencyMsMax = 0;
+	size_t blocks = 0;
+	std::vector<float> output;
+};
+
+static bool read_all(int fd, void* data, size_t size)
+{
+	auto bytes = static_cast<uint8_t*>(data);
+
+	while (size > 0)
+	{
+		ssize_t bytesRead = recv(fd, bytes, size, 0);
+
+		if (bytesRead <= 0)
+			return false;
+
+		bytes += bytesRead;
+		size -= (size_t)bytesRead;
+	}
+
+	return true;
+}
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+
+	while (size > 0)
+	{
+		ssize_t written = send(fd, bytes, size, 0);
+
+		if (written <= 0)
+			return false;
+
+		bytes += written;
+		size -= (size_t)written;
+	}
+
+	return true;
+}
+
+static void run_stream(const std::string& socketPath, const NAM::Stream::OpenRequest& request, const std::vector<float>& input,
+	uint32_t blockSize, StreamResult& result)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if ((fd < 0) || (connect(fd, (const sockaddr*)&address, sizeof(address)) < 0))
+	{
+		perror("connect");
+
+		if (fd >= 0)
+			close(fd);
+
+		return;
+	}
+
+	NAM::Stream::OpenResponse response;
+
+	if (!write_all(fd, &request, sizeof(request)) || !read_all(fd, &response, sizeof(response)))
+	{
+		close(fd);
+
+		return;
+	}
+
+	if (response.status != NAM::Stream::kOpenOk)
+	{
+		fprintf(stderr, "Server refused stream (status %d)\n", response.status);
+
+		close(fd);
+
+		return;
+	}
+
+	blockSize = std::min(blockSize, response.maxBlockSize);
+
+	result.output.resize(input.size());
+
+	for (size_t offset = 0; offset < input.size(); offset += blockSize)
+	{
+		NAM::Stream::BlockHeader header = { (uint32_t)std::min((size_t)blockSize, input.size() - offset) };
+
+		auto start = Clock::now();
+
+		if (!write_all(fd, &header, sizeof(header)) || !write_all(fd, input.data() + offset, header.numSamples * sizeof(float)))
+			break;
+
+		NAM::Stream::BlockHeader reply;
+
+		if (!read_all(fd, &reply, sizeof(reply)) || (reply.numSamples != header.numSamples) ||
+			!read_all(fd, result.output.data() + offset, reply.numSamples * sizeof(float)))
+			break;
+
+		double latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		result.latencyMsTotal += latencyMs;
+		result.latencyMsMax = std::max(result.latencyMsMax, latencyMs);
+		result.blocks++;
+
+		if ((offset + blockSize) >= input.size())
+			result.ok = true;
+	}
+
+	NAM::Stream::BlockHeader end = { 0 };
+	write_all(fd, &end, sizeof(end));
+
+	close(fd);
+}
+
+static void print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s --in <input.f32> [options]\n"
+		"  --socket <path>       Server socket (default: /tmp/nam_server.sock)\n"
+		"  --model <path>        Model file, resolved by the server (default: none)\n"
+		"  --out <output.f32>    Where to write the processed audio of the first stream\n"
+		"  --block <samples>     Block size (default: 128)\n"
+		"  --input-db <db>       Input level (default: 0)\n"
+		"  --output-db <db>      Output level (default: 0)\n"
+		"  --quality <scale>     Quality scale (default: 1)\n"
+		"  --streams <count>     Concurrent streams to run (default: 1)\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string socketPath = "/tmp/nam_server.sock";
+	std::string inputPath;
+	std::string outputPath;
+	uint32_t blockSize = 128;
+	int numStreams = 1;
+
+	NAM::Stream::OpenRequest request = { NAM::Stream::MAGIC, NAM::Stream::VERSION, 0, 0, 1, {} };
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (value == nullptr)
+		{
+			print_usage(argv[0]);
+
+			return 1;
+		}
+
+		if (!strcmp(arg, "--socket"))
+			socketPath = value;
+		else if (!strcmp(arg, "--model"))
+			strncpy(request.modelPath, value, NAM::Stream::MAX_MODEL_PATH - 1);
+		else if (!strcmp(arg, "--in"))
+			inputPath = value;
+		else if (!strcmp(arg, "--out"))
+			outputPath = value;
+		else if (!strcmp(arg, "--block"))
+			blockSize = (uint32_t)atoi(value);
+		else if (!strcmp(arg, "--input-db"))
+			request.inputLevelDB = (float)atof(value);
+		else if (!strcmp(arg, "--output-db"))
+			request.outputLevelDB = (float)atof(value);
+		else if (!strcmp(arg, "--quality"))
+			request.qualityScale = (float)atof(value);
+		else if (!strcmp(arg, "--streams"))
+			numStreams = atoi(value);
+		else
+		{
+			print_usage(argv[0]);
+
+			return 1;
+		}
+
+		i++;
+	}
+
+	if (inputPath.empty() || (blockSize == 0) || (numStreams < 1))
+	{
+		print_usage(argv[0]);
+
+		return 1;
+	}
+
+	std::vector<float> input;
+
+	if (FILE* file = fopen(inputPath.c_str(), "rb"))
+	{
+		float buffer[4096];
+		size_t count;
+
+		while ((count = fread(buffer, sizeof(float), 4096, file)) > 0)
+			input.insert(input.end(), buffer, buffer + count);
+
+		fclose(file);
+	}
+	else
+	{
+		fprintf(stderr, "Unable to read input: '%s'\n", inputPath.c_str());
+
+		return 1;
+	}
+
+	std::vector<StreamResult> results(numStreams);
+	std::vector<std::thread> threads;
+
+	auto start = Clock::now();
+
+	for (int i = 0; i < numStreams; i++)
+		threads.emplace_back(run_stream, socketPath, std::cref(request), std::cref(input), blockSize, std::ref(results[i]));
+
+	for (auto& thread : threads)
+		thread.join();
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	int failedStreams = 0;
+
+	for (int i = 0; i < numStreams; i++)
+	{
+		if (!results[i].ok)
+		{
+			failedStreams++;
+
+			continue;
+		}
+
+		printf("stream %d: latency avg %.3f ms max %.3f ms\n", i, results[i].latencyMsTotal / results[i].blocks, results[i].latencyMsMax);
+	}
+
+	printf("%d/%d streams, %.0f samples/s total\n", numStreams - failedStreams, numStreams,
+		(double)input.size() * (numStreams - failedStreams) / seconds);
+
+	if (!outputPath.empty() && results[0].ok)
+	{
+		if (FILE* file = fopen(outputPath.c_str(), "wb"))
+		{
+			fwrite(results[0].output.data(), sizeof(float), results[0].output.size(), file);
+			fclose(file);
+		}
+	}
+
+	return (failedStreams == 0) ? 0 : 1;
+}
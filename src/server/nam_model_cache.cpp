@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include "nam_model_cache.h"
+#include "nam_model_history.h"
+
+namespace NAM {
+	ModelCache::ModelCache(double sampleRate, int maxBlockSize, size_t maxIdlePerModel) :
+		maxBlockSize(maxBlockSize),
+		maxIdlePerModel(maxIdlePerModel)
+	{
+		loader.SetExternalSampleRate((int)sampleRate);
+		loader.SetDefaultMaxAudioBufferSize(maxBlockSize);
+	}
+
+	ModelCache::~ModelCache()
+	{
+		for (auto& idle : idleModels)
+		{
+			for (auto model : idle.second)
+				delete model;
+		}
+
+		// any still active models are owned by their stream's plugin
+	}
+
+	NeuralAudio::NeuralModel* ModelCache::acquire(const std::string& path, float qualityScale)
+	{
+		NeuralAudio::NeuralModel* model = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto idle = idleModels.find(path);
+
+			if ((idle != idleModels.end()) && !idle->second.empty())
+			{
+				model = idle->second.back();
+				idle->second.pop_back();
+
+				activeModels[model] = path;
+				numReuses++;
+			}
+		}
+
+		if (model != nullptr)
+		{
+			// don't let the previous stream's tail leak into this one
+			reset_model_history(model, maxBlockSize);
+
+			return model;
+		}
+
+		try
+		{
+			std::lock_guard<std::mutex> lock(loaderMutex);
+
+			loader.SetDefaultQualityScaleFactor(qualityScale);
+
+			model = loader.CreateFromFile(path);
+		}
+		catch (const std::exception&)
+		{
+			model = nullptr;
+		}
+
+		if (model != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			activeModels[model] = path;
+			numLoads++;
+		}
+
+		return model;
+	}
+
+	void ModelCache::release(NeuralAudio::NeuralModel* model)
+	{
+		if (model == nullptr)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto active = activeModels.find(model);
+
+			if (active != activeModels.end())
+			{
+				auto& idle = idleModels[active->second];
+
+				activeModels.erase(active);
+
+				if (idle.size() < maxIdlePerModel)
+				{
+					idle.push_back(model);
+
+					return;
+				}
+			}
+		}
+
+		delete model;
+	}
+
+	size_t ModelCache::get_num_loads() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return numLoads;
+	}
+
+	size_t ModelCache::get_num_reuses() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		return numReuses;
+	}
+
+	size_t ModelCache::get_num_instances() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		size_t count = activeModels.size();
+
+		for (auto& idle : idleModels)
+			count += idle.second.size();
+
+		return count;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <NeuralAudio/NeuralModel.h>
+
+namespace NAM {
+	// Models shared between server streams. Model instances carry their own sample history,
+	// so a stream gets exclusive use of an instance while it runs. When the stream ends the
+	// instance goes back to the cache, and the next stream naming the same file reuses it
+	// instead of parsing the file again.
+	class ModelCache {
+	public:
+		ModelCache(double sampleRate, int maxBlockSize, size_t maxIdlePerModel);
+		~ModelCache();
+
+		ModelCache(const ModelCache&) = delete;
+		ModelCache& operator=(const ModelCache&) = delete;
+
+		// Returns nullptr if the model could not be loaded. Can take a while (it may parse the model
+		// file), so the server only calls it from its load pool.
+		NeuralAudio::NeuralModel* acquire(const std::string& path, float qualityScale);
+		void release(NeuralAudio::NeuralModel* model);
+
+		size_t get_num_loads() const;
+		size_t get_num_reuses() const;
+		size_t get_num_instances() const;
+
+	private:
+		mutable std::mutex mutex;
+		std::mutex loaderMutex;
+
+		NeuralAudio::NeuralModelLoader loader;
+		int maxBlockSize;
+		size_t maxIdlePerModel;
+
+		std::unordered_map<std::string, std::vector<NeuralAudio::NeuralModel*>> idleModels;
+		std::unordered_map<NeuralAudio::NeuralModel*, std::string> activeModels;
+
+		size_t numLoads = 0;
+		size_t numReuses = 0;
+	};
+}
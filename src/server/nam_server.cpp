@@ -0,0 +1,625 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "nam_server.h"
+
+namespace NAM {
+	static uint64_t elapsed_ns(Session::Clock::time_point start, Session::Clock::time_point end)
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	}
+
+	// Sends as much as the socket takes without blocking. Returns the number of bytes sent, or -1 if the connection is gone.
+	static ssize_t send_available(int fd, const uint8_t* bytes, size_t size)
+	{
+		size_t sent = 0;
+
+		while (sent < size)
+		{
+			ssize_t written = send(fd, bytes + sent, size - sent, 0);
+
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+
+				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+					break;
+
+				return -1;
+			}
+
+			sent += (size_t)written;
+		}
+
+		return (ssize_t)sent;
+	}
+
+	Session::Session(Server& server, uint32_t id, int fd) :
+		id(id),
+		fd(fd),
+		server(server),
+		maxOutboxSize(MAX_PENDING_OUTPUT_BLOCKS * (sizeof(Stream::BlockHeader) + server.settings.maxBlockSize * sizeof(float)))
+	{
+		host.set_free_model_function([&server](NeuralAudio::NeuralModel* model) { server.models.release(model); });
+	}
+
+	Session::~Session()
+	{
+	}
+
+	bool Session::read_available()
+	{
+		uint8_t buffer[65536];
+
+		ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+
+		if (bytesRead == 0)
+			return false;
+
+		if (bytesRead < 0)
+			return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+
+		inbox.insert(inbox.end(), buffer, buffer + bytesRead);
+
+		size_t offset = 0;
+		bool open = true;
+
+		for (;;)
+		{
+			size_t available = inbox.size() - offset;
+
+			if (!requestReceived)
+			{
+				if (available < sizeof(Stream::OpenRequest))
+					break;
+
+				memcpy(&request, inbox.data() + offset, sizeof(request));
+				offset += sizeof(request);
+
+				requestReceived = true;
+
+				start_open();
+
+				continue;
+			}
+
+			Stream::BlockHeader header;
+
+			if (available < sizeof(header))
+				break;
+
+			memcpy(&header, inbox.data() + offset, sizeof(header));
+
+			if ((header.numSamples == 0) || (header.numSamples > (uint32_t)server.settings.maxBlockSize))
+			{
+				// end of stream, or a client ignoring the block size we told it
+				open = false;
+
+				break;
+			}
+
+			size_t payloadSize = header.numSamples * sizeof(float);
+
+			if (available < (sizeof(header) + payloadSize))
+				break;
+
+			Job job = { kJobBlock, std::vector<float>(header.numSamples), {} };
+
+			memcpy(job.samples.data(), inbox.data() + offset + sizeof(header), payloadSize);
+			offset += sizeof(header) + payloadSize;
+
+			job.received = Clock::now();
+
+			enqueue(std::move(job));
+		}
+
+		inbox.erase(inbox.begin(), inbox.begin() + offset);
+
+		return open;
+	}
+
+	void Session::finish_input()
+	{
+		enqueue({ kJobClose, {}, Clock::now() });
+	}
+
+	bool Session::has_pending_output() const
+	{
+		std::lock_guard<std::mutex> lock(outputMutex);
+
+		return !outbox.empty();
+	}
+
+	void Session::write_pending()
+	{
+		bool closeNow;
+
+		{
+			std::lock_guard<std::mutex> lock(outputMutex);
+
+			ssize_t written = send_available(fd, outbox.data(), outbox.size());
+
+			if (written < 0)
+			{
+				outputFailed = true;
+				outbox.clear();
+			}
+			else
+			{
+				outbox.erase(outbox.begin(), outbox.begin() + written);
+			}
+
+			closeNow = closeRequested && outbox.empty();
+		}
+
+		if (closeNow)
+			close_connection();
+	}
+
+	std::string Session::get_model_path() const
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+
+		return modelPath;
+	}
+
+	void Session::start_open()
+	{
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+
+			// hold back the blocks that arrive while the model loads - they are processed once it is ready
+			scheduled = true;
+		}
+
+		server.get_load_pool().submit([self = shared_from_this()]
+		{
+			self->open_stream();
+
+			self->server.get_pool().submit([self] { self->run_jobs(); });
+		});
+	}
+
+	void Session::enqueue(Job&& job)
+	{
+		bool schedule;
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+
+			if (job.type == kJobBlock)
+				queuedBlocks++;
+
+			jobs.push_back(std::move(job));
+
+			schedule = !scheduled;
+			scheduled = true;
+		}
+
+		if (schedule)
+			server.get_pool().submit([self = shared_from_this()] { self->run_jobs(); });
+	}
+
+	void Session::run_jobs()
+	{
+		for (int i = 0; i < MAX_JOBS_PER_TASK; i++)
+		{
+			Job job;
+
+			{
+				std::lock_guard<std::mutex> lock(jobMutex);
+
+				if (jobs.empty())
+				{
+					scheduled = false;
+
+					return;
+				}
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			switch (job.type)
+			{
+				case kJobBlock:
+					process_block(job);
+					queuedBlocks--;
+					break;
+
+				case kJobClose:
+					close_stream();
+					break;
+			}
+		}
+
+		// give other streams a turn - we are still marked as scheduled, so ordering is kept
+		server.get_pool().submit([self = shared_from_this()] { self->run_jobs(); });
+	}
+
+	void Session::open_stream()
+	{
+		NAM_TRACE_ZONE("stream open");
+
+		Stream::OpenResponse response = { Stream::kOpenOk, (uint32_t)server.settings.sampleRate, (uint32_t)server.settings.maxBlockSize };
+
+		request.modelPath[Stream::MAX_MODEL_PATH - 1] = '\0';
+
+		if ((request.magic != Stream::MAGIC) || (request.version != Stream::VERSION) || (strlen(request.modelPath) >= MAX_FILE_NAME))
+		{
+			response.status = Stream::kOpenBadRequest;
+		}
+		else if (!host.initialize(server.settings.sampleRate, server.settings.maxBlockSize))
+		{
+			response.status = Stream::kOpenBadRequest;
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(jobMutex);
+
+				modelPath = request.modelPath;
+			}
+
+			float qualityScale = std::clamp(request.qualityScale, 0.0f, 1.0f);
+
+			host.set_levels(request.inputLevelDB, request.outputLevelDB);
+			host.set_quality_scale(qualityScale);
+
+			if (request.modelPath[0] != '\0')
+			{
+				NeuralAudio::NeuralModel* model = server.models.acquire(request.modelPath, qualityScale);
+
+				if (model == nullptr)
+				{
+					fprintf(stderr, "stream %u: unable to load model from: '%s'\n", id, request.modelPath);
+
+					response.status = Stream::kOpenModelFailed;
+				}
+				else
+				{
+					host.set_model(model, request.modelPath);
+				}
+			}
+		}
+
+		failed = (response.status != Stream::kOpenOk);
+
+		if (!send_output(&response, sizeof(response)))
+			failed = true;
+	}
+
+	void Session::process_block(Job& job)
+	{
+		if (failed)
+			return;
+
+		uint32_t numSamples = (uint32_t)job.samples.size();
+
+		auto start = Clock::now();
+
+		host.process(job.samples.data(), job.samples.data(), numSamples);
+
+		auto processed = Clock::now();
+
+		Stream::BlockHeader header = { numSamples };
+
+		if (!send_output(&header, sizeof(header)) || !send_output(job.samples.data(), numSamples * sizeof(float)))
+		{
+			failed = true;
+
+			return;
+		}
+
+		uint64_t latencyNs = elapsed_ns(job.received, Clock::now());
+
+		stats.blocks++;
+		stats.samples += numSamples;
+		stats.processNsTotal += elapsed_ns(start, processed);
+		stats.latencyNsTotal += latencyNs;
+
+		if (latencyNs > stats.latencyNsMax)
+			stats.latencyNsMax = latencyNs;
+
+		server.add_processed_samples(numSamples);
+	}
+
+	void Session::close_stream()
+	{
+		// hands the model back to the cache through the plugin's normal free path - there is none if the
+		// stream never got as far as opening
+		if (host.is_initialized())
+			host.set_model(nullptr, nullptr);
+
+		bool closeNow;
+
+		{
+			std::lock_guard<std::mutex> lock(outputMutex);
+
+			closeRequested = true;
+			closeNow = outbox.empty();
+		}
+
+		// otherwise the I/O thread closes the connection once the client has taken the rest of its output
+		if (closeNow)
+			close_connection();
+	}
+
+	void Session::close_connection()
+	{
+		close(fd);
+
+		server.remove_session(this);
+	}
+
+	bool Session::send_output(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+
+		std::lock_guard<std::mutex> lock(outputMutex);
+
+		if (outputFailed)
+			return false;
+
+		// anything still waiting in the outbox has to go first
+		if (outbox.empty())
+		{
+			ssize_t written = send_available(fd, bytes, size);
+
+			if (written < 0)
+			{
+				outputFailed = true;
+
+				return false;
+			}
+
+			bytes += written;
+			size -= (size_t)written;
+		}
+
+		if (size > 0)
+		{
+			if ((outbox.size() + size) > maxOutboxSize)
+			{
+				// client isn't reading its replies
+				outputFailed = true;
+				outbox.clear();
+
+				return false;
+			}
+
+			outbox.insert(outbox.end(), bytes, bytes + size);
+		}
+
+		return true;
+	}
+
+	Server::Server(const Settings& settings) :
+		settings(settings),
+		models(settings.sampleRate, settings.maxBlockSize, settings.maxIdlePerModel),
+		pool((settings.numThreads > 0) ? settings.numThreads : std::max(1u, std::thread::hardware_concurrency())),
+		loadPool(1)
+	{
+	}
+
+	Server::~Server()
+	{
+		if (listenFd >= 0)
+		{
+			close(listenFd);
+			unlink(settings.socketPath.c_str());
+		}
+	}
+
+	bool Server::start()
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+
+		if (settings.socketPath.length() >= sizeof(address.sun_path))
+		{
+			fprintf(stderr, "Socket path is too long: '%s'\n", settings.socketPath.c_str());
+
+			return false;
+		}
+
+		strncpy(address.sun_path, settings.socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (listenFd < 0)
+		{
+			perror("socket");
+
+			return false;
+		}
+
+		// remove a stale socket left behind by a previous run
+		unlink(settings.socketPath.c_str());
+
+		if ((bind(listenFd, (const sockaddr*)&address, sizeof(address)) < 0) || (listen(listenFd, SOMAXCONN) < 0))
+		{
+			perror("bind");
+
+			close(listenFd);
+			listenFd = -1;
+
+			return false;
+		}
+
+		fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+		printf("Listening on %s (%.0f Hz, max block %d, %u threads)\n", settings.socketPath.c_str(), settings.sampleRate,
+			settings.maxBlockSize, pool.get_num_threads());
+
+		return true;
+	}
+
+	void Server::run(const std::atomic<bool>& stop)
+	{
+		std::vector<std::shared_ptr<Session>> reading;
+		std::vector<std::shared_ptr<Session>> polled;
+		std::vector<std::shared_ptr<Session>> writing;
+		std::vector<pollfd> fds;
+
+		lastStatsTime = Session::Clock::now();
+
+		while (!stop)
+		{
+			fds.clear();
+			polled.clear();
+			writing.clear();
+
+			fds.push_back({ listenFd, POLLIN, 0 });
+
+			for (auto& session : reading)
+			{
+				// stop reading from streams that are too far behind until their backlog drains
+				if (session->get_queued_blocks() < MAX_QUEUED_BLOCKS)
+				{
+					fds.push_back({ session->fd, POLLIN, 0 });
+					polled.push_back(session);
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(sessionsMutex);
+
+				for (auto& session : sessions)
+				{
+					if (session->has_pending_output())
+					{
+						fds.push_back({ session->fd, POLLOUT, 0 });
+						writing.push_back(session);
+					}
+				}
+			}
+
+			int ready = poll(fds.data(), (nfds_t)fds.size(), POLL_TIMEOUT_MS);
+
+			if ((ready < 0) && (errno != EINTR))
+			{
+				perror("poll");
+
+				break;
+			}
+
+			if (ready > 0)
+			{
+				for (size_t i = 0; i < polled.size(); i++)
+				{
+					if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+					{
+						if (!polled[i]->read_available())
+						{
+							polled[i]->finish_input();
+
+							reading.erase(std::find(reading.begin(), reading.end(), polled[i]));
+						}
+					}
+				}
+
+				for (size_t i = 0; i < writing.size(); i++)
+				{
+					if (fds[i + 1 + polled.size()].revents & (POLLOUT | POLLHUP | POLLERR))
+						writing[i]->write_pending();
+				}
+
+				if (fds[0].revents & POLLIN)
+					accept_connections(reading);
+			}
+
+			if ((settings.statsInterval > 0) &&
+				(std::chrono::duration<double>(Session::Clock::now() - lastStatsTime).count() >= settings.statsInterval))
+			{
+				print_stats();
+			}
+		}
+
+		for (auto& session : reading)
+			session->finish_input();
+	}
+
+	void Server::accept_connections(std::vector<std::shared_ptr<Session>>& reading)
+	{
+		for (;;)
+		{
+			int fd = accept(listenFd, nullptr, nullptr);
+
+			if (fd < 0)
+				return;
+
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+			auto session = std::make_shared<Session>(*this, nextSessionId++, fd);
+
+			{
+				std::lock_guard<std::mutex> lock(sessionsMutex);
+
+				sessions.push_back(session);
+			}
+
+			reading.push_back(session);
+		}
+	}
+
+	void Server::add_processed_samples(uint32_t numSamples)
+	{
+		totalSamples.fetch_add(numSamples, std::memory_order_relaxed);
+	}
+
+	void Server::remove_session(Session* session)
+	{
+		uint64_t blocks = session->stats.blocks;
+
+		printf("stream %u closed: %llu samples, latency avg %.3f ms max %.3f ms\n", session->id,
+			(unsigned long long)session->stats.samples.load(),
+			(blocks > 0) ? ((double)session->stats.latencyNsTotal / blocks / 1e6) : 0.0,
+			(double)session->stats.latencyNsMax / 1e6);
+
+		std::lock_guard<std::mutex> lock(sessionsMutex);
+
+		sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+			[session](const std::shared_ptr<Session>& s) { return s.get() == session; }), sessions.end());
+	}
+
+	void Server::print_stats()
+	{
+		auto now = Session::Clock::now();
+		double seconds = std::chrono::duration<double>(now - lastStatsTime).count();
+
+		uint64_t samples = totalSamples;
+		double samplesPerSecond = (seconds > 0) ? ((samples - lastStatsSamples) / seconds) : 0;
+
+		lastStatsSamples = samples;
+		lastStatsTime = now;
+
+		std::lock_guard<std::mutex> lock(sessionsMutex);
+
+		printf("streams: %zu  throughput: %.0f samples/s (%.1fx realtime)  models: %zu instances, %zu loads, %zu reuses\n",
+			sessions.size(), samplesPerSecond, samplesPerSecond / settings.sampleRate,
+			models.get_num_instances(), models.get_num_loads(), models.get_num_reuses());
+
+		for (auto& session : sessions)
+		{
+			uint64_t blocks = session->stats.blocks;
+
+			printf("  stream %u [%s]: %llu blocks, latency avg %.3f ms max %.3f ms, process avg %.3f ms\n",
+				session->id, session->get_model_path().c_str(), (unsigned long long)blocks,
+				(blocks > 0) ? ((double)session->stats.latencyNsTotal / blocks / 1e6) : 0.0,
+				(double)session->stats.latencyNsMax / 1e6,
+				(blocks > 0) ? ((double)session->stats.processNsTotal / blocks / 1e6) : 0.0);
+		}
+
+		fflush(stdout);
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "nam_host.h"
+#include "nam_model_cache.h"
+#include "nam_stream_protocol.h"
+#include "nam_thread_pool.h"
+
+namespace NAM {
+	class Server;
+
+	// One client connection. The I/O thread parses incoming blocks and queues them, and the
+	// queue is drained by at most one pool task at a time, so a stream's blocks are processed
+	// and answered in order while different streams run in parallel.
+	class Session : public std::enable_shared_from_this<Session> {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		struct Stats {
+			std::atomic<uint64_t> blocks = 0;
+			std::atomic<uint64_t> samples = 0;
+			std::atomic<uint64_t> latencyNsTotal = 0;
+			std::atomic<uint64_t> latencyNsMax = 0;
+			std::atomic<uint64_t> processNsTotal = 0;
+		};
+
+		const uint32_t id;
+		const int fd;
+
+		Stats stats;
+
+		Session(Server& server, uint32_t id, int fd);
+		~Session();
+
+		// I/O thread only. Returns false once the client has ended the stream or the connection is gone.
+		bool read_available();
+		// I/O thread only. Queues the end of the stream after all received blocks.
+		void finish_input();
+		// I/O thread only. Output that didn't fit in the socket buffer waits here for the socket to become writable.
+		bool has_pending_output() const;
+		void write_pending();
+
+		size_t get_queued_blocks() const { return queuedBlocks.load(std::memory_order_relaxed); }
+		std::string get_model_path() const;
+
+	private:
+		static constexpr int MAX_JOBS_PER_TASK = 8;
+		// blocks of output a client can fall behind by before its stream fails
+		static constexpr size_t MAX_PENDING_OUTPUT_BLOCKS = 64;
+
+		enum JobType {
+			kJobBlock,
+			kJobClose
+		};
+
+		struct Job {
+			JobType type;
+			std::vector<float> samples;
+			Clock::time_point received;
+		};
+
+		void start_open();
+		void enqueue(Job&& job);
+		void run_jobs();
+
+		void open_stream();
+		void process_block(Job& job);
+		void close_stream();
+
+		void close_connection();
+
+		bool send_output(const void* data, size_t size);
+
+		Server& server;
+
+		// I/O thread state
+		std::vector<uint8_t> inbox;
+		bool requestReceived = false;
+		Stream::OpenRequest request = {};
+
+		// pool task state - only touched by the task currently draining the queue
+		Host host;
+		bool failed = false;
+
+		mutable std::mutex jobMutex;
+		std::deque<Job> jobs;
+		bool scheduled = false;
+		std::atomic<size_t> queuedBlocks = 0;
+
+		std::string modelPath;
+
+		// Pool tasks send what the socket takes and leave the rest to the I/O thread, so a client that
+		// stops reading never holds up a pool thread
+		mutable std::mutex outputMutex;
+		std::vector<uint8_t> outbox;
+		const size_t maxOutboxSize;
+		bool outputFailed = false;
+		bool closeRequested = false;
+	};
+
+	class Server {
+	public:
+		struct Settings {
+			std::string socketPath = "/tmp/nam_server.sock";
+			double sampleRate = 48000;
+			int maxBlockSize = 512;
+			unsigned int numThreads = 0;
+			double statsInterval = 5;
+			size_t maxIdlePerModel = 4;
+		};
+
+		const Settings settings;
+
+		ModelCache models;
+
+		explicit Server(const Settings& settings);
+		~Server();
+
+		bool start();
+		void run(const std::atomic<bool>& stop);
+
+		WorkStealingPool& get_pool() { return pool; }
+		WorkStealingPool& get_load_pool() { return loadPool; }
+
+		void add_processed_samples(uint32_t numSamples);
+		void remove_session(Session* session);
+
+		void print_stats();
+
+	private:
+		static constexpr size_t MAX_QUEUED_BLOCKS = 64;
+		static constexpr int POLL_TIMEOUT_MS = 10;
+
+		void accept_connections(std::vector<std::shared_ptr<Session>>& reading);
+
+		int listenFd = -1;
+		uint32_t nextSessionId = 1;
+
+		std::mutex sessionsMutex;
+		std::vector<std::shared_ptr<Session>> sessions;
+
+		std::atomic<uint64_t> totalSamples = 0;
+		uint64_t lastStatsSamples = 0;
+		Session::Clock::time_point lastStatsTime;
+
+		// declared last so queued tasks finish before anything they reference goes away
+		WorkStealingPool pool;
+
+		// Stream opens (which may load a model from disk) run here, so they never hold up audio
+		// processing. Declared after the processing pool, which its tasks hand off to.
+		WorkStealingPool loadPool;
+	};
+}
@@ -0,0 +1,107 @@
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "nam_server.h"
+
+static std::atomic<bool> stopRequested = false;
+
+static void handle_signal(int)
+{
+	stopRequested = true;
+}
+
+static void print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  --socket <path>         Local socket to listen on (default: /tmp/nam_server.sock)\n"
+		"  --rate <hz>             Sample rate of all streams (default: 48000)\n"
+		"  --max-block <samples>   Largest block a client may send (default: 512)\n"
+		"  --threads <count>       Processing threads (default: hardware concurrency)\n"
+		"  --stats <seconds>       Metrics reporting interval, 0 to disable (default: 5)\n"
+		"  --idle-models <count>   Idle instances kept per model file (default: 4)\n"
+#ifdef TRACING_ENABLED
+		"  --trace <file>          Write a Chrome/Perfetto trace on shutdown\n"
+#endif
+		, name);
+}
+
+int main(int argc, char* argv[])
+{
+	NAM::Server::Settings settings;
+#ifdef TRACING_ENABLED
+	const char* traceFile = nullptr;
+#endif
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (value == nullptr)
+		{
+			print_usage(argv[0]);
+
+			return 1;
+		}
+
+		if (!strcmp(arg, "--socket"))
+			settings.socketPath = value;
+		else if (!strcmp(arg, "--rate"))
+			settings.sampleRate = atof(value);
+		else if (!strcmp(arg, "--max-block"))
+			settings.maxBlockSize = atoi(value);
+		else if (!strcmp(arg, "--threads"))
+			settings.numThreads = (unsigned int)atoi(value);
+		else if (!strcmp(arg, "--stats"))
+			settings.statsInterval = atof(value);
+		else if (!strcmp(arg, "--idle-models"))
+			settings.maxIdlePerModel = (size_t)atoi(value);
+#ifdef TRACING_ENABLED
+		else if (!strcmp(arg, "--trace"))
+			traceFile = value;
+#endif
+		else
+		{
+			print_usage(argv[0]);
+
+			return 1;
+		}
+
+		i++;
+	}
+
+	if ((settings.sampleRate <= 0) || (settings.maxBlockSize <= 0))
+	{
+		print_usage(argv[0]);
+
+		return 1;
+	}
+
+	signal(SIGINT, handle_signal);
+	signal(SIGTERM, handle_signal);
+	signal(SIGPIPE, SIG_IGN);	// a client going away shows up as a failed send instead
+
+	{
+		NAM::Server server(settings);
+
+		if (!server.start())
+			return 1;
+
+		server.run(stopRequested);
+	}
+
+#ifdef TRACING_ENABLED
+	// the server is gone, so every stream has finished
+	if ((traceFile != nullptr) && !NAM::Trace::write_chrome_trace(traceFile))
+	{
+		fprintf(stderr, "Unable to write trace to: '%s'\n", traceFile);
+
+		return 1;
+	}
+#endif
+
+	return 0;
+}
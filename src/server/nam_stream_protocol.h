@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Wire format between nam_server and its clients. All values are in native byte order,
+// since the server only listens on a local socket.
+namespace NAM::Stream {
+	static constexpr uint32_t MAGIC = 0x534d414e;	// "NAMS"
+	static constexpr uint32_t VERSION = 1;
+	static constexpr unsigned int MAX_MODEL_PATH = 1024;
+
+	// Sent once by the client after connecting. An empty model path gives a plain gain stage.
+	struct OpenRequest {
+		uint32_t magic;
+		uint32_t version;
+		float inputLevelDB;
+		float outputLevelDB;
+		float qualityScale;
+		char modelPath[MAX_MODEL_PATH];
+	};
+
+	enum OpenStatus : int32_t {
+		kOpenOk = 0,
+		kOpenBadRequest,
+		kOpenModelFailed
+	};
+
+	// Sent by the server in reply to an OpenRequest
+	struct OpenResponse {
+		int32_t status;
+		uint32_t sampleRate;
+		uint32_t maxBlockSize;
+	};
+
+	// Every audio block, in either direction, is a BlockHeader followed by numSamples floats.
+	// Blocks come back in the order they were sent. A zero-length block from the client ends the stream.
+	struct BlockHeader {
+		uint32_t numSamples;
+	};
+}
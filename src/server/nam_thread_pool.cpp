@@ -0,0 +1,117 @@
+#include "nam_thread_pool.h"
+
+namespace NAM {
+	// pool worker running on this thread, if any
+	static thread_local const WorkStealingPool* currentPool = nullptr;
+	static thread_local int currentWorkerIndex = -1;
+
+	WorkStealingPool::WorkStealingPool(unsigned int numThreads)
+	{
+		if (numThreads == 0)
+			numThreads = 1;
+
+		for (unsigned int i = 0; i < numThreads; i++)
+			queues.push_back(std::make_unique<TaskQueue>());
+
+		for (unsigned int i = 0; i < numThreads; i++)
+			threads.emplace_back(&WorkStealingPool::worker_loop, this, i);
+	}
+
+	WorkStealingPool::~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+
+			stopping = true;
+		}
+
+		wakeCondition.notify_all();
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	void WorkStealingPool::submit(Task task)
+	{
+		// tasks submitted from a worker stay local to keep the data they touch in cache
+		unsigned int index = (currentPool == this) ? (unsigned int)currentWorkerIndex :
+			(nextQueue.fetch_add(1, std::memory_order_relaxed) % (unsigned int)queues.size());
+
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+
+			queues[index]->tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+
+			pendingTasks++;
+		}
+
+		wakeCondition.notify_one();
+	}
+
+	bool WorkStealingPool::pop_local(unsigned int index, Task& task)
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+
+		if (queues[index]->tasks.empty())
+			return false;
+
+		task = std::move(queues[index]->tasks.back());
+		queues[index]->tasks.pop_back();
+
+		return true;
+	}
+
+	bool WorkStealingPool::steal(unsigned int index, Task& task)
+	{
+		unsigned int numQueues = (unsigned int)queues.size();
+
+		for (unsigned int offset = 1; offset < numQueues; offset++)
+		{
+			auto& victim = queues[(index + offset) % numQueues];
+
+			std::lock_guard<std::mutex> lock(victim->mutex);
+
+			if (!victim->tasks.empty())
+			{
+				task = std::move(victim->tasks.front());
+				victim->tasks.pop_front();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void WorkStealingPool::worker_loop(unsigned int index)
+	{
+		currentPool = this;
+		currentWorkerIndex = (int)index;
+
+		for (;;)
+		{
+			Task task;
+
+			if (pop_local(index, task) || steal(index, task))
+			{
+				pendingTasks--;
+
+				task();
+
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(wakeMutex);
+
+			wakeCondition.wait(lock, [this] { return stopping || (pendingTasks > 0); });
+
+			// only exit once everything that was submitted has run
+			if (stopping && (pendingTasks == 0))
+				return;
+		}
+	}
+}
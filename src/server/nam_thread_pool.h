@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NAM {
+	// Fixed-size pool where each worker owns a task deque. Workers take their own newest
+	// task first and steal the oldest task from another worker when they run dry.
+	// The pool makes no ordering guarantees - callers that need ordering (ie: blocks of one
+	// stream) must serialize their own tasks.
+	class WorkStealingPool {
+	public:
+		using Task = std::function<void()>;
+
+		explicit WorkStealingPool(unsigned int numThreads);
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool&) = delete;
+		WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+		void submit(Task task);
+
+		unsigned int get_num_threads() const { return (unsigned int)threads.size(); }
+
+	private:
+		struct TaskQueue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void worker_loop(unsigned int index);
+		bool pop_local(unsigned int index, Task& task);
+		bool steal(unsigned int index, Task& task);
+
+		std::vector<std::unique_ptr<TaskQueue>> queues;
+		std::vector<std::thread> threads;
+
+		std::atomic<unsigned int> nextQueue = 0;
+		std::atomic<int> pendingTasks = 0;
+		bool stopping = false;
+
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+	};
+}